@@ -0,0 +1,197 @@
+"""
+    Nonce capture files (software/src/capture.h).
+
+    The CLI appends the nonces of every nested, staticnested, static encrypted nonce, darkside
+    and detection log acquisition to one file per card, so they can be solved again offline. The solvers in
+    bin/ take a capture file in place of the nonces:
+        nested <file>, staticnested <file>, staticencnested <file>, darkside <file>, mfkey32batch <file>,
+        hardnested <file>
+    Hardnested records are not acquired by the CLI yet, CaptureWriter.hardnested() imports them.
+
+    `python chameleon_capture.py <files...>` runs the solvers matching the records of each file.
+    mfdictcheck checks a dictionary against all the records of a file, see dict_check().
+"""
+import struct
+import subprocess
+import sys
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+MAGIC = b"CUNC"
+VERSION = 1
+# magic version header_size prng sak atqa uid_len rfu uid auth_uid
+HEADER = struct.Struct("<4sBBBB2sBB10sI")
+RECORD = struct.Struct("<BB")
+
+PRNG_STATIC = 0
+PRNG_WEAK = 1
+PRNG_HARD = 2
+PRNG_UNKNOWN = 0xFF
+
+# record types, bit 0 of `key` is set for key B
+NESTED = 1
+STATIC_NESTED = 2
+DARKSIDE = 3
+AUTH = 4
+STATIC_ENC_NESTED = 5
+HARDNESTED = 6
+# flags of the static nested records
+RUN_START = 0x01
+PAYLOADS = {
+    NESTED: (struct.Struct("<BBBxIII"), ("block", "key", "par", "dist", "nt", "nt_enc")),
+    # bit 0 of `flags`: first nonce of an acquisition
+    STATIC_NESTED: (struct.Struct("<BBBxII"), ("block", "key", "flags", "nt", "nt_enc")),
+    DARKSIDE: (struct.Struct("<BBxxIIIQQ"), ("block", "key", "nt", "nr", "ar", "par_list", "ks_list")),
+    # bit 1 of `key`: nested authentication
+    AUTH: (struct.Struct("<BBxxIIII"), ("block", "key", "uid", "nt", "nr", "ar")),
+    # nt of the known key authentication, nt_enc the static encrypted nonce of the target
+    STATIC_ENC_NESTED: (struct.Struct("<BBxxII"), ("block", "key", "nt", "nt_enc")),
+    # bit b of `par`: encrypted parity bit of byte b of nt_enc
+    HARDNESTED: (struct.Struct("<BBBxI"), ("block", "key", "par", "nt_enc")),
+}
+# solver of each record type
+SOLVERS = {NESTED: "nested", STATIC_NESTED: "staticnested", DARKSIDE: "darkside", AUTH: "mfkey32batch",
+           STATIC_ENC_NESTED: "staticencnested", HARDNESTED: "hardnested"}
+
+# well-known keys checked when no dictionary is given
+DEFAULT_KEYS = ["ffffffffffff", "000000000000", "a0a1a2a3a4a5", "b0b1b2b3b4b5", "d3f7d3f7d3f7", "aabbccddeeff",
+                "4d3a99c351dd", "1a982c7e459a", "714c5c886e97", "587ee5f9350f", "a0478cc39091", "533cb6c723f6",
+                "8fd0a4f256e9", "a64598a77478", "26940b21ff5d", "fc00018778f7", "00000ffe2488", "5c598c9c58b5",
+                "e4d2770a89be"]
+
+CAPTURE_DIR = Path(__file__).with_name("captures")
+BIN_DIR = Path(__file__).with_name("bin")
+
+
+def capture_path(uid: int) -> Path:
+    """
+        Default capture file of the card with this (4 byte) uid
+    """
+    return CAPTURE_DIR / f"{uid:08X}.nonces"
+
+
+def candidate_path(uid: int, block: int, key_bit: int) -> Path:
+    """
+        Candidate cache the nested solvers carry over between the retries on one key (`-c` option)
+    """
+    return CAPTURE_DIR / f"{uid:08X}.{block}{'AB'[key_bit & 1]}.cand"
+
+
+class CaptureWriter:
+    """
+        Appends records to a capture file, the header is written when the file is new.
+        The header of an existing file is kept as it is.
+    """
+
+    def __init__(self, path: Path, auth_uid: int, uid: bytes = b"", atqa: bytes = b"\x00\x00", sak: int = 0,
+                 prng: int = PRNG_UNKNOWN):
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        self.file = open(self.path, "ab")
+        if self.file.tell() == 0:
+            uid = bytes(uid or auth_uid.to_bytes(4, "big"))[:10]
+            self.file.write(HEADER.pack(MAGIC, VERSION, HEADER.size, prng, sak, bytes(atqa)[:2], len(uid), 0,
+                                        uid, auth_uid))
+            self.file.flush()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        self.file.close()
+
+    def append(self, record_type: int, **fields):
+        payload, names = PAYLOADS[record_type]
+        data = payload.pack(*[fields[name] for name in names])
+        self.file.write(RECORD.pack(record_type, len(data)) + data)
+        self.file.flush()
+
+    def nested(self, block: int, key: int, dist: int, nt: int, nt_enc: int, par: int):
+        self.append(NESTED, block=block, key=key, par=par, dist=dist, nt=nt, nt_enc=nt_enc)
+
+    def static_nested(self, block: int, key: int, nt: int, nt_enc: int, first: bool = False):
+        self.append(STATIC_NESTED, block=block, key=key, flags=RUN_START if first else 0, nt=nt, nt_enc=nt_enc)
+
+    def darkside(self, block: int, key: int, nt: int, nr: int, ar: int, par_list: int, ks_list: int):
+        self.append(DARKSIDE, block=block, key=key, nt=nt, nr=nr, ar=ar, par_list=par_list, ks_list=ks_list)
+
+    def static_enc_nested(self, block: int, key: int, nt: int, nt_enc: int):
+        self.append(STATIC_ENC_NESTED, block=block, key=key, nt=nt, nt_enc=nt_enc)
+
+    def hardnested(self, block: int, key: int, nt_enc: int, par: int):
+        self.append(HARDNESTED, block=block, key=key, par=par, nt_enc=nt_enc)
+
+    def auth(self, block: int, key: int, uid: int, nt: int, nr: int, ar: int):
+        self.append(AUTH, block=block, key=key, uid=uid, nt=nt, nr=nr, ar=ar)
+
+
+def read(path: Path) -> Tuple[dict, List[Tuple[int, dict]]]:
+    """
+        Header and (type, fields) records of a capture file, unknown record types are skipped.
+        Raises ValueError if it isn't a capture file of a version this reader knows.
+    """
+    data = Path(path).read_bytes()
+    if len(data) < HEADER.size or data[:4] != MAGIC:
+        raise ValueError(f"{path} is not a capture file")
+    _, version, header_size, prng, sak, atqa, uid_len, _, uid, auth_uid = HEADER.unpack_from(data)
+    if version > VERSION or header_size < HEADER.size:
+        raise ValueError(f"{path} has capture version {version}, this reader knows up to {VERSION}")
+    header = {"version": version, "prng": prng, "sak": sak, "atqa": atqa, "uid": uid[:uid_len],
+              "auth_uid": auth_uid}
+    records = []
+    pos = header_size
+    while pos + RECORD.size <= len(data):
+        record_type, size = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        if pos + size > len(data):
+            break  # interrupted write
+        if record_type in PAYLOADS and size >= PAYLOADS[record_type][0].size:
+            payload, names = PAYLOADS[record_type]
+            records.append((record_type, dict(zip(names, payload.unpack_from(data, pos)))))
+        pos += size
+    return header, records
+
+
+def solve(path: Path) -> str:
+    """
+        Output of the solvers of all the record types in a capture file
+    """
+    _, records = read(path)
+    output = ""
+    for record_type in sorted({record_type for record_type, _ in records}):
+        tool = SOLVERS[record_type] + (".exe" if sys.platform == "win32" else "")
+        result = subprocess.run([str(BIN_DIR / tool), str(path)], capture_output=True, text=True)
+        output += f"[{SOLVERS[record_type]}]\n{result.stdout}"
+    return output
+
+
+def dict_check(path: Path, dictionary: str = None) -> Dict[Tuple[int, int, str], List[str]]:
+    """
+        Keys of a .dic file, or DEFAULT_KEYS, matching the records of a capture file, by (uid, block, key type).
+        Checked offline by mfdictcheck, empty if it isn't built.
+    """
+    tool = BIN_DIR / ("mfdictcheck.exe" if sys.platform == "win32" else "mfdictcheck")
+    if not tool.exists() or not Path(path).exists():
+        return {}
+    keys = "" if dictionary else "".join(f"{key}\n" for key in DEFAULT_KEYS)
+    result = subprocess.run([str(tool), str(path), dictionary or "-"], input=keys, capture_output=True, text=True)
+    found = {}
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[2] in ("A", "B"):
+            found.setdefault((int(fields[0], 16), int(fields[1]), fields[2]), []).append(fields[3])
+    return found
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(f"syntax: {sys.argv[0]} <capture file>...")
+        sys.exit(1)
+    for capture in sys.argv[1:]:
+        try:
+            print(f"{capture}:\n{solve(Path(capture))}")
+        except (OSError, ValueError) as e:
+            print(f"{capture}: {e}")
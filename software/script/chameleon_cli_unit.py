@@ -1,5 +1,6 @@
 import binascii
 import os
+import queue
 import re
 import subprocess
 import argparse
@@ -16,8 +17,11 @@ from pathlib import Path
 from platform import uname
 from datetime import datetime
 
+import chameleon_capture
 import chameleon_com
 import chameleon_cmd
+import chameleon_crack
+import chameleon_jobs
 from chameleon_utils import ArgumentParserNoExit, ArgsParserError, UnexpectedResponseError
 from chameleon_utils import CLITree
 from chameleon_utils import CR, CG, CB, CC, CY, C0
@@ -44,7 +48,7 @@ default_cwd = Path.cwd() / Path(__file__).with_name("bin")
 
 
 def check_tools():
-    tools = ['staticnested', 'nested', 'darkside', 'mfkey32v2']
+    tools = ['staticnested', 'nested', 'darkside', 'mfkey32v2', 'mfkey32batch']
     if sys.platform == "win32":
         tools = [x+'.exe' for x in tools]
     missing_tools = [tool for tool in tools if not (default_cwd / tool).exists()]
@@ -190,6 +194,22 @@ class ReaderRequiredUnit(DeviceRequiredUnit):
                 return True
         return False
 
+    def open_capture(self, auth_uid: int, prng: int) -> chameleon_capture.CaptureWriter:
+        """
+            Capture file of the card, a new one gets the uid, atqa and sak of the card in the field.
+
+        :param auth_uid: uid used in the authentications
+        :param prng: chameleon_capture.PRNG_*
+        :return:
+        """
+        path = chameleon_capture.capture_path(auth_uid)
+        uid, atqa, sak = b"", b"\x00\x00", 0
+        if not path.exists():
+            tags = self.cmd.hf14a_scan()
+            if tags is not None and len(tags) == 1:
+                uid, atqa, sak = tags[0]['uid'], tags[0]['atqa'], tags[0]['sak'][0]
+        return chameleon_capture.CaptureWriter(path, auth_uid, uid, atqa, sak, prng)
+
 
 class SlotIndexArgsUnit(DeviceRequiredUnit):
     @staticmethod
@@ -693,12 +713,16 @@ class HFMFNested(ReaderRequiredUnit):
         srctype_group.add_argument('-a', '-A', action='store_true', help="Known key is A key (default)")
         srctype_group.add_argument('-b', '-B', action='store_true', help="Known key is B key")
         parser.add_argument('-k', '--key', type=str, required=True, metavar="<hex>", help="Known key")
-        # tblk required because only single block mode is supported for now
-        parser.add_argument('--tblk', '--target-block', type=int, required=True, metavar="<dec>",
-                            help="Target key block number")
+        parser.add_argument('--tblk', '--target-block', type=int, required=True, metavar="<dec>", nargs='+',
+                            help="Target key block number(s), the keys of several blocks are solved at once")
         dsttype_group = parser.add_mutually_exclusive_group()
         dsttype_group.add_argument('--ta', '--tA', action='store_true', help="Target A key (default)")
         dsttype_group.add_argument('--tb', '--tB', action='store_true', help="Target B key")
+        parser.add_argument('--mem', type=int, metavar="<MB>",
+                            help="Memory cap of the recovery, in MB (slower when it is below ~8 MB per thread)")
+        parser.add_argument('--dic', type=str, metavar="<file>",
+                            help="Keys checked offline against the nonces before the recovery "
+                                 "(.dic format, default: well-known keys)")
         return parser
 
     def from_nt_level_code_to_str(self, nt_level):
@@ -709,76 +733,212 @@ class HFMFNested(ReaderRequiredUnit):
         if nt_level == 2:
             return 'HardNested'
 
-    def recover_a_key(self, block_known, type_known, key_known, block_target, type_target) -> Union[str, None]:
+    def submit_recovery(self, block_known, type_known, key_known, block_target, type_target,
+                        mem=None, dic=None, threads=None,
+                        streamed: queue.Queue = None) -> Union[str, chameleon_jobs.Job, None]:
         """
-            recover a key from key known.
+            Acquire the nonces of a key and submit their solve to the job scheduler.
 
         :param block_known:
         :param type_known:
         :param key_known:
         :param block_target:
         :param type_target:
-        :return:
+        :param mem: memory cap of the recovery tool in MB, None for no cap
+        :param dic: .dic file checked against the nonces first, None for the well-known keys
+        :param threads: thread quota of the job, None for every core
+        :param streamed: gets the likely keys as the tool finds them, see try_streamed
+        :return: the key if a dictionary key matches, else the job to pass to verify_recovery, None if unsupported
         """
         # check nt level, we can run static or nested auto...
         nt_level = self.cmd.mf1_detect_prng()
         print(f" - NT vulnerable: {CY}{ self.from_nt_level_code_to_str(nt_level) }{C0}")
-        if nt_level == 2:
-            print(" [!] HardNested has not been implemented yet.")
-            return None
-
         # acquire
-        if nt_level == 0:  # It's a staticnested tag?
+        key_bit = 1 if type_target == MfcKeyType.B else 0
+        if nt_level == 2:
             nt_uid_obj = self.cmd.mf1_static_nested_acquire(
                 block_known, type_known, key_known, block_target, type_target)
-            cmd_param = f"{nt_uid_obj['uid']} {int(type_target)}"
+            # a static encrypted nonce tag reuses nt and its keystream, {nt} is the same after another auth
+            if nt_uid_obj['nts'][0]['nt_enc'] != nt_uid_obj['nts'][1]['nt_enc']:
+                print(" [!] HardNested acquisition is not supported by the firmware yet,")
+                print("     nonces collected elsewhere can be added to a capture file (CaptureWriter.hardnested)")
+                print("     and solved with the offline `hardnested` tool.")
+                return None
+            print(" - Static encrypted nonce, {nt} of the other sectors acquired as well")
+            uid = nt_uid_obj['uid']
+            with self.open_capture(uid, nt_level) as capture:
+                nonces = self.static_enc_nonces(block_known, type_known, key_known, block_target, type_target,
+                                                nt_uid_obj, capture)
+            cmd_param = [uid, nonces.pop(block_target)] + list(nonces.values())
+            tool_name = "staticencnested"
+        elif nt_level == 0:  # It's a staticnested tag?
+            nt_uid_obj = self.cmd.mf1_static_nested_acquire(
+                block_known, type_known, key_known, block_target, type_target)
+            cmd_param = [nt_uid_obj['uid'], int(type_target)]
             for nt_item in nt_uid_obj['nts']:
-                cmd_param += f" {nt_item['nt']} {nt_item['nt_enc']}"
+                cmd_param += [nt_item['nt'], nt_item['nt_enc']]
             tool_name = "staticnested"
+            uid = nt_uid_obj['uid']
+            with self.open_capture(nt_uid_obj['uid'], nt_level) as capture:
+                for index, nt_item in enumerate(nt_uid_obj['nts']):
+                    capture.static_nested(block_target, key_bit, nt_item['nt'], nt_item['nt_enc'], index == 0)
         else:
             dist_obj = self.cmd.mf1_detect_nt_dist(block_known, type_known, key_known)
             nt_obj = self.cmd.mf1_nested_acquire(block_known, type_known, key_known, block_target, type_target)
-            # create cmd
-            cmd_param = f"{dist_obj['uid']} {dist_obj['dist']}"
+            cmd_param = [dist_obj['uid'], dist_obj['dist']]
             for nt_item in nt_obj:
-                cmd_param += f" {nt_item['nt']} {nt_item['nt_enc']} {nt_item['par']}"
+                cmd_param += [nt_item['nt'], nt_item['nt_enc'], nt_item['par']]
             tool_name = "nested"
+            uid = dist_obj['uid']
+            with self.open_capture(dist_obj['uid'], nt_level) as capture:
+                for nt_item in nt_obj:
+                    capture.nested(block_target, key_bit, dist_obj['dist'], nt_item['nt'], nt_item['nt_enc'],
+                                   nt_item['par'])
+        print(f"   Nonces saved to {capture.path}")
+        cache = chameleon_capture.candidate_path(uid, block_target, key_bit)
+        # a dictionary key the nonces agree with needs no recovery
+        found = chameleon_capture.dict_check(capture.path, dic).get((uid, block_target, "AB"[key_bit]), [])
+        for key in found:
+            if self.cmd.mf1_auth_one_key_block(block_target, type_target, bytearray.fromhex(key)):
+                print("   Dictionary key matches the nonces")
+                cache.unlink(missing_ok=True)
+                return key
+
+        # the candidates of the earlier tries on this key narrow down those of this one
+        options = ["-c", cache] + (["-m", mem] if mem is not None else [])
+        on_line = None
+        if streamed is not None:
+            options.append("-s")
+
+            def on_line(line):
+                sea_obj = re.match(r"Candidate ([a-fA-F0-9]{12})", line)
+                if sea_obj is not None:
+                    streamed.put(sea_obj[1])
+        job = chameleon_jobs.Job(tool_name, options + cmd_param, threads=threads,
+                                 target=(uid, block_target, key_bit), on_line=on_line)
+        print(f"   Submitted {tool_name} {' '.join(str(param) for param in cmd_param)}")
+        return chameleon_jobs.scheduler().submit(job)
+
+    def static_enc_nonces(self, block_known, type_known, key_known, block_target, type_target, nt_uid_obj,
+                          capture: chameleon_capture.CaptureWriter) -> dict:
+        """
+            {nt} of the target and of the other sectors of a static encrypted nonce tag, for the same key type:
+            the solver needs those of sectors sharing the key. A sector always gives the same {nt}, those
+            already in the capture file are not acquired again.
 
-        # Cross-platform compatibility
-        if sys.platform == "win32":
-            cmd_recover = f"{tool_name}.exe {cmd_param}"
-        else:
-            cmd_recover = f"./{tool_name} {cmd_param}"
+        :param nt_uid_obj: acquisition of the target
+        :return: {nt} by block
+        """
+        key_bit = 1 if type_target == MfcKeyType.B else 0
+        nonces = {}
+        _, records = chameleon_capture.read(capture.path)
+        for record_type, fields in records:
+            if record_type == chameleon_capture.STATIC_ENC_NESTED and fields['key'] == key_bit:
+                nonces.setdefault(fields['block'], fields['nt_enc'])
+        nt_item = nt_uid_obj['nts'][0]
+        if nonces.get(block_target) != nt_item['nt_enc']:
+            nonces[block_target] = nt_item['nt_enc']
+            capture.static_enc_nested(block_target, key_bit, nt_item['nt'], nt_item['nt_enc'])
+        # sector trailers of a 1K card
+        for block in range(3, 64, 4):
+            if any(known // 4 == block // 4 for known in nonces):
+                continue
+            try:
+                nt_item = self.cmd.mf1_static_nested_acquire(
+                    block_known, type_known, key_known, block, type_target)['nts'][0]
+            except UnexpectedResponseError:
+                continue
+            nonces[block] = nt_item['nt_enc']
+            capture.static_enc_nested(block, key_bit, nt_item['nt'], nt_item['nt_enc'])
+        return nonces
+
+    @staticmethod
+    def key_verified(job: chameleon_jobs.Job, block_target):
+        """
+            The key of the target of the job is known, drop its candidates and its remaining solve
+        """
+        uid, _, key_bit = job.target
+        chameleon_capture.candidate_path(uid, block_target, key_bit).unlink(missing_ok=True)
+        chameleon_jobs.scheduler().cancel(job.target)
 
-        print(f"   Executing {cmd_recover}")
-        # start a decrypt process
-        process = self.sub_process(cmd_recover)
+    def try_streamed(self, job: chameleon_jobs.Job, streamed: queue.Queue, tried: set, block_target,
+                     type_target) -> Union[str, None]:
+        """
+            Try on the card the likely keys the solve has streamed so far, it is stopped on a match.
 
-        # wait end
-        while process.is_running():
-            msg = f"   [ Time elapsed {process.get_time_distance()/1000:#.1f}s ]\r"
-            print(msg, end="")
-            time.sleep(0.1)
-        # clear \r
-        print()
+        :param tried: keys already tried, updated
+        :return: the key the card accepts, None if none yet
+        """
+        while True:
+            try:
+                key = streamed.get_nowait()
+            except queue.Empty:
+                return None
+            if key in tried:
+                continue
+            tried.add(key)
+            if self.cmd.mf1_auth_one_key_block(block_target, type_target, bytearray.fromhex(key)):
+                self.key_verified(job, block_target)
+                return key
 
-        if process.get_ret_code() == 0:
-            output_str = process.get_output_sync()
-            key_list = []
-            for line in output_str.split('\n'):
-                sea_obj = re.search(r"([a-fA-F0-9]{12})", line)
-                if sea_obj is not None:
-                    key_list.append(sea_obj[1])
-            # Here you have to verify the password first, and then get the one that is successfully verified
-            # If there is no verified password, it means that the recovery failed, you can try again
-            print(f" - [{len(key_list)} candidate key(s) found ]")
-            for key in key_list:
-                key_bytes = bytearray.fromhex(key)
-                if self.cmd.mf1_auth_one_key_block(block_target, type_target, key_bytes):
-                    return key
-        else:
-            # No keys recover, and no errors.
+    def verify_recovery(self, job: chameleon_jobs.Job, block_target, type_target, tried=()) -> Union[str, None]:
+        """
+            Try the candidates of a finished solve on the card.
+
+        :param tried: keys already tried while streaming
+        :return: the key the card accepts, None if none
+        """
+        if not job.ok():
             return None
+        key_list = []
+        for line in job.output.split('\n'):
+            if line.startswith("Candidate"):
+                continue
+            sea_obj = re.search(r"([a-fA-F0-9]{12})", line)
+            if sea_obj is not None:
+                key_list.append(sea_obj[1])
+        # Here you have to verify the password first, and then get the one that is successfully verified
+        # If there is no verified password, it means that the recovery failed, you can try again
+        print(f" - Block {block_target} Type {type_target.name}: [{len(key_list)} candidate key(s) found ]")
+        for key in key_list:
+            if key in tried:
+                continue
+            key_bytes = bytearray.fromhex(key)
+            if self.cmd.mf1_auth_one_key_block(block_target, type_target, key_bytes):
+                self.key_verified(job, block_target)
+                return key
+        return None
+
+    def recover_a_key(self, block_known, type_known, key_known, block_target, type_target,
+                      mem=None, dic=None) -> Union[str, None]:
+        """
+            recover a key from key known.
+
+        :param block_known:
+        :param type_known:
+        :param key_known:
+        :param block_target:
+        :param type_target:
+        :param mem: memory cap of the recovery tool in MB, None for no cap
+        :param dic: .dic file checked against the nonces first, None for the well-known keys
+        :return:
+        """
+        streamed = queue.Queue()
+        tried = set()
+        job = self.submit_recovery(block_known, type_known, key_known, block_target, type_target, mem, dic,
+                                   streamed=streamed)
+        if not isinstance(job, chameleon_jobs.Job):
+            return job
+        # wait end, the likely keys are tried on the card meanwhile
+        while not job.wait(0.1):
+            key = self.try_streamed(job, streamed, tried, block_target, type_target)
+            if key is not None:
+                print(f"\n   Streamed candidate verified after {job.elapsed():#.1f}s, solve stopped")
+                return key
+            print(f"   [ Time elapsed {job.elapsed():#.1f}s ]\r", end="")
+        # clear \r
+        print()
+        return self.verify_recovery(job, block_target, type_target, tried)
 
     def on_exec(self, args: argparse.Namespace):
         block_known = args.blk
@@ -789,18 +949,53 @@ class HFMFNested(ReaderRequiredUnit):
             print("key must include 12 HEX symbols")
             return
         key_known_bytes = bytes.fromhex(key_known)
-        block_target = args.tblk
         # default to A
         type_target = MfcKeyType.B if args.tb else MfcKeyType.A
-        if block_known == block_target and type_known == type_target:
+        targets = [block for block in dict.fromkeys(args.tblk)
+                   if block != block_known or type_known != type_target]
+        if len(targets) == 0:
             print(f"{CR}Target key already known{C0}")
             return
-        print(f" - {C0}Nested recover one key running...{C0}")
-        key = self.recover_a_key(block_known, type_known, key_known_bytes, block_target, type_target)
-        if key is None:
-            print(f"{CY}No key found, you can retry.{C0}")
-        else:
-            print(f" - Block {block_target} Type {type_target.name} Key Found: {CG}{key}{C0}")
+        if len(targets) == 1:
+            print(f" - {C0}Nested recover one key running...{C0}")
+            key = self.recover_a_key(block_known, type_known, key_known_bytes, targets[0], type_target, args.mem,
+                                     args.dic)
+            if key is None:
+                print(f"{CY}No key found, you can retry.{C0}")
+            else:
+                print(f" - Block {targets[0]} Type {type_target.name} Key Found: {CG}{key}{C0}")
+            return
+
+        # the card acquires the next target while the solves of the previous ones run
+        print(f" - {C0}Nested recover {len(targets)} keys running...{C0}")
+        scheduler = chameleon_jobs.scheduler()
+        threads = max(1, scheduler.cores // len(targets))
+        jobs = {}
+        keys = {}
+        for block in targets:
+            streamed = queue.Queue()
+            result = self.submit_recovery(block_known, type_known, key_known_bytes, block, type_target, args.mem,
+                                          args.dic, threads, streamed)
+            if isinstance(result, chameleon_jobs.Job):
+                jobs[result] = (block, streamed, set())
+            else:
+                keys[block] = result
+        while jobs:
+            for job, (block, streamed, tried) in list(jobs.items()):
+                key = self.try_streamed(job, streamed, tried, block, type_target)
+                if key is not None:
+                    jobs.pop(job)
+                    keys[block] = key
+            for job in scheduler.wait_any(jobs, 0.1):
+                block, _, tried = jobs.pop(job)
+                keys[block] = self.verify_recovery(job, block, type_target, tried)
+            print(f"   [ {scheduler.status()} ]\r", end="")
+        print()
+        for block in targets:
+            if keys.get(block) is None:
+                print(f" - Block {block} Type {type_target.name}: {CY}No key found, you can retry.{C0}")
+            else:
+                print(f" - Block {block} Type {type_target.name} Key Found: {CG}{keys[block]}{C0}")
         return
 
 
@@ -825,49 +1020,70 @@ class HFMFDarkside(ReaderRequiredUnit):
         """
         first_recover = True
         retry_count = 0
-        while retry_count < 0xFF:
-            darkside_resp = self.cmd.mf1_darkside_acquire(block_target, type_target, first_recover, 30)
-            first_recover = False  # not first run.
-            if darkside_resp[0] != MifareClassicDarksideStatus.OK:
-                print(f"Darkside error: {MifareClassicDarksideStatus(darkside_resp[0])}")
-                break
-            darkside_obj = darkside_resp[1]
-
-            if darkside_obj['par'] != 0:  # NXP tag workaround.
-                self.darkside_list.clear()
-
-            self.darkside_list.append(darkside_obj)
-            recover_params = f"{darkside_obj['uid']}"
-            for darkside_item in self.darkside_list:
-                recover_params += f" {darkside_item['nt1']} {darkside_item['ks1']} {darkside_item['par']}"
-                recover_params += f" {darkside_item['nr']} {darkside_item['ar']}"
-            if sys.platform == "win32":
-                cmd_recover = f"darkside.exe {recover_params}"
-            else:
-                cmd_recover = f"./darkside {recover_params}"
-            # subprocess.run(cmd_recover, cwd=os.path.abspath("../bin/"), shell=True)
-            # print(f"   Executing {cmd_recover}")
-            # start a decrypt process
-            process = self.sub_process(cmd_recover)
-            # wait end
-            process.wait_process()
-            # get output
-            output_str = process.get_output_sync()
-            if 'key not found' in output_str:
-                print(f" - No key found, retrying({retry_count})...")
-                retry_count += 1
-                continue  # retry
-            else:
-                key_list = []
-                for line in output_str.split('\n'):
-                    sea_obj = re.search(r"([a-fA-F0-9]{12})", line)
-                    if sea_obj is not None:
-                        key_list.append(sea_obj[1])
-                # auth key
-                for key in key_list:
-                    key_bytes = bytearray.fromhex(key)
-                    if self.cmd.mf1_auth_one_key_block(block_target, type_target, key_bytes):
-                        return key
+        crack = chameleon_crack.load()
+        session = None
+        capture = None
+        try:
+            while retry_count < 0xFF:
+                darkside_resp = self.cmd.mf1_darkside_acquire(block_target, type_target, first_recover, 30)
+                first_recover = False  # not first run.
+                if darkside_resp[0] != MifareClassicDarksideStatus.OK:
+                    print(f"Darkside error: {MifareClassicDarksideStatus(darkside_resp[0])}")
+                    break
+                darkside_obj = darkside_resp[1]
+                if session is None and crack is not None:
+                    session = crack.darkside_session(darkside_obj['uid'])
+
+                if capture is None:
+                    capture = self.open_capture(darkside_obj['uid'], chameleon_capture.PRNG_WEAK)
+                capture.darkside(block_target, 1 if type_target == MfcKeyType.B else 0, darkside_obj['nt1'],
+                                 darkside_obj['nr'], darkside_obj['ar'], darkside_obj['par'], darkside_obj['ks1'])
+
+                if darkside_obj['par'] != 0:  # NXP tag workaround.
+                    self.darkside_list.clear()
+
+                self.darkside_list.append(darkside_obj)
+                if session is not None:
+                    # only the new nonce is solved, against the candidates kept in the session
+                    key_list = [f"{key:012x}" for key in session.add(darkside_obj)]
+                    if len(key_list) == 0:
+                        print(f" - No key found, retrying({retry_count})...")
+                        retry_count += 1
+                        continue  # retry
+                    for key in key_list:
+                        if self.cmd.mf1_auth_one_key_block(block_target, type_target, bytearray.fromhex(key)):
+                            return key
+                    continue
+                recover_params = [darkside_obj['uid']]
+                for darkside_item in self.darkside_list:
+                    recover_params += [darkside_item['nt1'], darkside_item['ks1'], darkside_item['par'],
+                                       darkside_item['nr'], darkside_item['ar']]
+                # the card waits for the result, ahead of the queued solves
+                job = chameleon_jobs.scheduler().submit(chameleon_jobs.Job(
+                    "darkside", recover_params, priority=chameleon_jobs.PRIORITY_INTERACTIVE, thread_option=False))
+                job.wait()
+                # get output
+                output_str = job.output
+                if 'key not found' in output_str:
+                    print(f" - No key found, retrying({retry_count})...")
+                    retry_count += 1
+                    continue  # retry
+                else:
+                    key_list = []
+                    for line in output_str.split('\n'):
+                        sea_obj = re.search(r"([a-fA-F0-9]{12})", line)
+                        if sea_obj is not None:
+                            key_list.append(sea_obj[1])
+                    # auth key
+                    for key in key_list:
+                        key_bytes = bytearray.fromhex(key)
+                        if self.cmd.mf1_auth_one_key_block(block_target, type_target, key_bytes):
+                            return key
+        finally:
+            if session is not None:
+                session.close()
+            if capture is not None:
+                capture.close()
         return None
 
     def on_exec(self, args: argparse.Namespace):
@@ -1226,6 +1442,14 @@ _KEY = re.compile("[a-fA-F0-9]{12}", flags=re.MULTILINE)
 
 
 def _run_mfkey32v2(items):
+    crack = chameleon_crack.load()
+    if crack is not None:
+        key = crack.mfkey32v2(*[int(x, 16) for x in (
+            items[0]["uid"], items[0]["nt"], items[0]["nr"], items[0]["ar"],
+            items[1]["nt"], items[1]["nr"], items[1]["ar"])])
+        if key is not None:
+            return f"{key:012x}", items
+        return None
     output_str = subprocess.run(
         [
             default_cwd / ("mfkey32v2.exe" if sys.platform == "win32" else "mfkey32v2"),
@@ -1302,6 +1526,11 @@ class HFMFELog(DeviceRequiredUnit):
         parser = ArgumentParserNoExit()
         parser.description = 'MF1 Detection log count/decrypt'
         parser.add_argument('--decrypt', action='store_true', help="Decrypt key from MF1 log list")
+        parser.add_argument('--mem', type=int, metavar="<MB>",
+                            help="Memory cap of the decryption, in MB (slower when it is below ~8 MB per thread)")
+        parser.add_argument('--dic', type=str, metavar="<file>",
+                            help="Keys checked offline against the log before the decryption "
+                                 "(.dic format, default: well-known keys)")
         return parser
 
     def decrypt_by_list(self, rs: list):
@@ -1326,6 +1555,92 @@ class HFMFELog(DeviceRequiredUnit):
         print()
         return gen.keys
 
+    @staticmethod
+    def decrypt_by_batch(result_list: list, result_maps: dict, mem=None) -> bool:
+        """
+            Decrypt the whole log in one mfkey32batch run, keys are shown as they are found
+
+        :param result_list: all the records
+        :param result_maps: uid -> block -> type -> records, records replaced by the set of keys found
+        :param mem: memory cap of mfkey32batch in MB, None for no cap
+        :return: False if mfkey32batch is not available
+        """
+        tool = default_cwd / ("mfkey32batch.exe" if sys.platform == "win32" else "mfkey32batch")
+        if not tool.exists():
+            return False
+        for blocks in result_maps.values():
+            for types in blocks.values():
+                for type in types:
+                    types[type] = set()
+
+        def on_line(line):
+            fields = line.split()
+            if len(fields) != 4:
+                # an error of the tool, like a --mem too small
+                print(f"  > {line.strip()}")
+                return
+            uid, block, type, key = fields
+            print(f"  > Block {block}, {type} key found for uid [{uid.upper()}]: {key}")
+            result_maps[uid][int(block)][type].add(key)
+
+        # the tool reads all the records before it starts solving
+        records = "".join("{uid},{block},{type},{nt},{nr},{ar}\n".format(**item) for item in result_list)
+        job = chameleon_jobs.Job("mfkey32batch", [] if mem is None else ["-m", mem], stdin=records,
+                                 on_line=on_line)
+        chameleon_jobs.scheduler().submit(job).wait()
+        return True
+
+    @staticmethod
+    def dict_check(result_maps: dict, dic=None) -> dict:
+        """
+            Dictionary keys matching the records, found offline with mfdictcheck before any decryption.
+
+        :param result_maps: records by uid, block and key type, as saved by save_captures
+        :param dic: .dic file, None for the well-known keys
+        :return: (uid, block, type) -> set of keys
+        """
+        known = {}
+        for uid, blocks in result_maps.items():
+            found = chameleon_capture.dict_check(chameleon_capture.capture_path(int(uid, 16)), dic)
+            for (found_uid, block, type), keys in found.items():
+                if found_uid == int(uid, 16) and type in blocks.get(block, {}):
+                    print(f"  > Block {block}, {type} key of uid [{uid.upper()}] in the dictionary: {', '.join(keys)}")
+                    known[(uid, block, type)] = set(keys)
+        return known
+
+    @staticmethod
+    def save_captures(result_maps: dict):
+        """
+            Append the records to the capture file of each uid, to solve them again with mfkey32batch.
+            The log is downloaded again on every run, the records already in the file are skipped.
+
+        :param result_maps: records by uid, block and key type
+        :return:
+        """
+        for uid, blocks in result_maps.items():
+            path = chameleon_capture.capture_path(int(uid, 16))
+            saved = set()
+            if path.exists():
+                try:
+                    saved = {(r['block'], r['key'], r['uid'], r['nt'], r['nr'], r['ar'])
+                             for t, r in chameleon_capture.read(path)[1] if t == chameleon_capture.AUTH}
+                except ValueError as e:
+                    print(f" - {e}, records of uid [{uid.upper()}] not saved")
+                    continue
+            added = 0
+            with chameleon_capture.CaptureWriter(path, int(uid, 16)) as capture:
+                for block, types in blocks.items():
+                    for type, items in types.items():
+                        for item in items:
+                            key = (1 if type == 'B' else 0) | (2 if item['is_nested'] else 0)
+                            fields = (block, key, int(uid, 16), int(item['nt'], 16), int(item['nr'], 16),
+                                      int(item['ar'], 16))
+                            if fields not in saved:
+                                saved.add(fields)
+                                capture.auth(*fields)
+                                added += 1
+            print(f" - {added} new records of uid [{uid.upper()}] saved to {capture.path}")
+
     def on_exec(self, args: argparse.Namespace):
         if not args.decrypt:
             count = self.cmd.mf1_get_detection_count()
@@ -1361,19 +1676,28 @@ class HFMFELog(DeviceRequiredUnit):
 
             result_maps[uid][block][type].append(item)
 
+        self.save_captures(result_maps)
+        known = self.dict_check(result_maps, args.dic)
+        pending = [item for item in result_list if (item['uid'], item['block'], item['type']) not in known]
+        batch = self.decrypt_by_batch(pending, result_maps, args.mem)
+        for (uid, block, type), keys in known.items():
+            result_maps[uid][block][type] = keys
         for uid in result_maps.keys():
             print(f" - Detection log for uid [{uid.upper()}]")
             result_maps_for_uid = result_maps[uid]
             for block in result_maps_for_uid:
+                if batch:
+                    break
                 print(f"  > Block {block} detect log decrypting...")
-                if 'A' in result_maps_for_uid[block]:
+                # the keys found in the dictionary need no decryption
+                if 'A' in result_maps_for_uid[block] and (uid, block, 'A') not in known:
                     # print(f" - A record: { result_maps[block]['A'] }")
                     records = result_maps_for_uid[block]['A']
                     if len(records) > 1:
                         result_maps[uid][block]['A'] = self.decrypt_by_list(records)
                     else:
                         print(f"  > {len(records)} record")
-                if 'B' in result_maps_for_uid[block]:
+                if 'B' in result_maps_for_uid[block] and (uid, block, 'B') not in known:
                     # print(f" - B record: { result_maps[block]['B'] }")
                     records = result_maps_for_uid[block]['B']
                     if len(records) > 1:
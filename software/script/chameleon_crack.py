@@ -0,0 +1,185 @@
+"""
+    ctypes binding of the chameleon_crack shared library (software/src/crack_api.h).
+
+    Runs the same solvers as the command line tools in bin/ inside the CLI process,
+    without starting a process and parsing its output for every solve.
+"""
+import ctypes
+import sys
+from pathlib import Path
+from typing import List, Union
+
+LIB_DIR = Path(__file__).with_name("bin")
+LIB_NAMES = {
+    "win32": ["chameleon_crack.dll", "libchameleon_crack.dll"],
+    "darwin": ["libchameleon_crack.dylib"],
+}
+LIB_VERSION = 2
+
+
+class NestedNonce(ctypes.Structure):
+    _fields_ = [("nt", ctypes.c_uint32), ("nt_enc", ctypes.c_uint32), ("par", ctypes.c_uint32)]
+
+
+class StaticNestedNonce(ctypes.Structure):
+    _fields_ = [("nt", ctypes.c_uint32), ("nt_enc", ctypes.c_uint32)]
+
+
+class DarksideNonce(ctypes.Structure):
+    _fields_ = [("nt", ctypes.c_uint32), ("nr", ctypes.c_uint32), ("ar", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32), ("par_list", ctypes.c_uint64), ("ks_list", ctypes.c_uint64)]
+
+
+class ChameleonCrack:
+    """
+        Typed wrappers around the library entry points, all nonce values are ints
+    """
+
+    def __init__(self, lib: ctypes.CDLL):
+        self.lib = lib
+        u32, u64 = ctypes.c_uint32, ctypes.c_uint64
+        keys_p = ctypes.POINTER(ctypes.POINTER(u64))
+        self._sig("chameleon_crack_version", u32)
+        self._sig("chameleon_crack_free", None, ctypes.c_void_p)
+        self._sig("chameleon_crack_nested", ctypes.c_int32,
+                  u32, u32, ctypes.POINTER(NestedNonce), u32, u32, keys_p)
+        self._sig("chameleon_crack_staticnested", ctypes.c_int32,
+                  u32, u32, ctypes.POINTER(StaticNestedNonce), u32, u32, keys_p)
+        self._sig("chameleon_crack_darkside", ctypes.c_int32,
+                  u32, ctypes.POINTER(DarksideNonce), u32, keys_p)
+        self._sig("chameleon_crack_darkside_begin", ctypes.c_void_p, u32)
+        self._sig("chameleon_crack_darkside_add", ctypes.c_int32,
+                  ctypes.c_void_p, ctypes.POINTER(DarksideNonce), keys_p)
+        self._sig("chameleon_crack_darkside_end", None, ctypes.c_void_p)
+        self._sig("chameleon_crack_mfkey32", ctypes.c_int32, *([u32] * 6), ctypes.POINTER(u64))
+        self._sig("chameleon_crack_mfkey32v2", ctypes.c_int32, *([u32] * 7), ctypes.POINTER(u64))
+        self._sig("chameleon_crack_mfkey64", ctypes.c_int32, *([u32] * 5), ctypes.POINTER(u64))
+
+    def _sig(self, name, restype, *argtypes):
+        func = getattr(self.lib, name)
+        func.restype = restype
+        func.argtypes = argtypes
+
+    def _key_list(self, count: int, keys) -> List[int]:
+        try:
+            return [keys[i] for i in range(max(count, 0))]
+        finally:
+            self.lib.chameleon_crack_free(keys)
+
+    def nested(self, uid: int, dist: int, nonces: list, threads: int = 0) -> List[int]:
+        """
+            Candidate keys of a nested attack, most likely first
+
+        :param nonces: dicts with nt, nt_enc and par, as returned by mf1_nested_acquire
+        """
+        arr = (NestedNonce * len(nonces))(*[NestedNonce(n['nt'], n['nt_enc'], n['par']) for n in nonces])
+        keys = ctypes.POINTER(ctypes.c_uint64)()
+        count = self.lib.chameleon_crack_nested(uid, dist, arr, len(nonces), threads, ctypes.byref(keys))
+        return self._key_list(count, keys)
+
+    def staticnested(self, uid: int, key_type: int, nonces: list, threads: int = 0) -> List[int]:
+        """
+            Candidate keys of a static nested attack, most likely first
+
+        :param nonces: dicts with nt and nt_enc, as returned by mf1_static_nested_acquire
+        """
+        arr = (StaticNestedNonce * len(nonces))(*[StaticNestedNonce(n['nt'], n['nt_enc']) for n in nonces])
+        keys = ctypes.POINTER(ctypes.c_uint64)()
+        count = self.lib.chameleon_crack_staticnested(uid, key_type, arr, len(nonces), threads, ctypes.byref(keys))
+        return self._key_list(count, keys)
+
+    def darkside(self, uid: int, nonces: list) -> List[int]:
+        """
+            Candidate keys of a darkside attack, empty if more nonces are needed
+
+        :param nonces: dicts with nt1, ks1, par, nr and ar, as returned by mf1_darkside_acquire
+        """
+        arr = (DarksideNonce * len(nonces))(*[
+            DarksideNonce(n['nt1'], n['nr'], n['ar'], 0, n['par'], n['ks1']) for n in nonces])
+        keys = ctypes.POINTER(ctypes.c_uint64)()
+        count = self.lib.chameleon_crack_darkside(uid, arr, len(nonces), ctypes.byref(keys))
+        return self._key_list(count, keys)
+
+    def darkside_session(self, uid: int) -> "DarksideSession":
+        """
+            Darkside solver keeping its candidates across retries, see DarksideSession
+        """
+        return DarksideSession(self, uid)
+
+    def mfkey32(self, uid: int, nt: int, nr0: int, ar0: int, nr1: int, ar1: int) -> Union[int, None]:
+        key = ctypes.c_uint64()
+        if self.lib.chameleon_crack_mfkey32(uid, nt, nr0, ar0, nr1, ar1, ctypes.byref(key)):
+            return key.value
+        return None
+
+    def mfkey32v2(self, uid: int, nt0: int, nr0: int, ar0: int, nt1: int, nr1: int, ar1: int) -> Union[int, None]:
+        key = ctypes.c_uint64()
+        if self.lib.chameleon_crack_mfkey32v2(uid, nt0, nr0, ar0, nt1, nr1, ar1, ctypes.byref(key)):
+            return key.value
+        return None
+
+    def mfkey64(self, uid: int, nt: int, nr: int, ar: int, at: int) -> Union[int, None]:
+        key = ctypes.c_uint64()
+        if self.lib.chameleon_crack_mfkey64(uid, nt, nr, ar, at, ctypes.byref(key)):
+            return key.value
+        return None
+
+
+class DarksideSession:
+    """
+        Darkside across retries: every nonce added is solved once and intersected with
+        the candidates left by the previous ones, instead of solving the whole list again.
+    """
+
+    def __init__(self, crack: ChameleonCrack, uid: int):
+        self.crack = crack
+        self.handle = crack.lib.chameleon_crack_darkside_begin(uid)
+        if not self.handle:
+            raise MemoryError("chameleon_crack_darkside_begin")
+
+    def add(self, nonce: dict) -> List[int]:
+        """
+            Solve one more nonce, returns the keys it gives, empty if more nonces are needed
+
+        :param nonce: dict with nt1, ks1, par, nr and ar, as returned by mf1_darkside_acquire
+        """
+        arr = DarksideNonce(nonce['nt1'], nonce['nr'], nonce['ar'], 0, nonce['par'], nonce['ks1'])
+        keys = ctypes.POINTER(ctypes.c_uint64)()
+        count = self.crack.lib.chameleon_crack_darkside_add(self.handle, ctypes.byref(arr), ctypes.byref(keys))
+        return self.crack._key_list(count, keys)
+
+    def close(self):
+        if self.handle:
+            self.crack.lib.chameleon_crack_darkside_end(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+
+_instance: Union[ChameleonCrack, None, bool] = False
+
+
+def load() -> Union[ChameleonCrack, None]:
+    """
+        Load the library once, None if it wasn't built or is of another version
+    """
+    global _instance
+    if _instance is not False:
+        return _instance
+    _instance = None
+    for name in LIB_NAMES.get(sys.platform, ["libchameleon_crack.so"]):
+        path = LIB_DIR / name
+        if not path.exists():
+            continue
+        try:
+            crack = ChameleonCrack(ctypes.CDLL(str(path)))
+        except (OSError, AttributeError):
+            continue
+        if crack.lib.chameleon_crack_version() == LIB_VERSION:
+            _instance = crack
+            break
+    return _instance
@@ -0,0 +1,211 @@
+"""
+    Solver job scheduler of the CLI.
+
+    The recovery commands submit their solver runs (nested, staticnested, darkside, mfkey32batch...)
+    as jobs instead of blocking on one subprocess after another. Jobs wait in a priority queue and
+    start as soon as their thread quota fits in the core budget, so several targets are solved at
+    once while the card goes on with the next acquisition. Cancelling a target, once its key is
+    verified, drops its queued jobs and kills the running ones.
+"""
+import heapq
+import itertools
+import os
+import subprocess
+import sys
+import threading
+import timeit
+from pathlib import Path
+from typing import Callable, Iterable, List, Union
+
+BIN_DIR = Path(__file__).with_name("bin")
+
+# priorities, PRIORITY_NORMAL for the solves nothing waits on
+PRIORITY_BATCH = -10
+PRIORITY_NORMAL = 0
+PRIORITY_INTERACTIVE = 10   # the card is waiting for the result
+
+# job states
+QUEUED = "queued"
+RUNNING = "running"
+DONE = "done"
+CANCELLED = "cancelled"
+
+
+class Job:
+    """
+        One run of a tool of bin/.
+
+        threads: cores the job may use, None for the whole budget. Tools taking `-t` get it as their
+                 thread count, the others only have the cores reserved.
+        priority: higher runs first, submission order among equals.
+        target: what the job solves, e.g. (uid, block, key type), see Scheduler.cancel().
+        on_line: called from the reader thread with every output line, as it comes.
+    """
+
+    def __init__(self, tool: str, args: Iterable = (), threads: Union[int, None] = None, priority: int = PRIORITY_NORMAL,
+                 target=None, stdin: str = None, thread_option: bool = True, on_line: Callable = None):
+        self.tool = tool
+        self.args = [str(arg) for arg in args]
+        self.threads = threads
+        self.priority = priority
+        self.target = target
+        self.stdin = stdin
+        self.thread_option = thread_option
+        self.on_line = on_line
+        self.state = QUEUED
+        self.quota = 0
+        self.output = ""    # whole output of the tool, set once the job is done
+        self.returncode = None
+        self.time_start = None
+        self.time_end = None
+        self._process = None
+        self._lines = []
+        self._done = threading.Event()
+
+    def command(self) -> List[str]:
+        tool = str(BIN_DIR / (self.tool + (".exe" if sys.platform == "win32" else "")))
+        if self.thread_option:
+            return [tool, "-t", str(self.quota)] + self.args
+        return [tool] + self.args
+
+    def done(self) -> bool:
+        return self._done.is_set()
+
+    def wait(self, timeout: float = None) -> bool:
+        return self._done.wait(timeout)
+
+    def ok(self) -> bool:
+        return self.state == DONE and self.returncode == 0
+
+    def elapsed(self) -> float:
+        """
+            Seconds the job has been running, 0 while queued
+        """
+        if self.time_start is None:
+            return 0.0
+        return (self.time_end or timeit.default_timer()) - self.time_start
+
+
+class Scheduler:
+    """
+        Runs the jobs submitted on at most `cores` cores together. A job asking for more than the
+        whole budget gets it all, once nothing else runs.
+    """
+
+    def __init__(self, cores: int = None):
+        self.cores = max(1, cores or os.cpu_count() or 1)
+        self._queue = []
+        self._running = []
+        self._used = 0
+        self._seq = itertools.count()
+        self._lock = threading.Condition()
+
+    def submit(self, job: Job) -> Job:
+        with self._lock:
+            heapq.heappush(self._queue, (-job.priority, next(self._seq), job))
+            self._dispatch()
+        return job
+
+    def cancel(self, target) -> int:
+        """
+            Cancel every job of a target, returns how many were queued or running
+        """
+        count = 0
+        with self._lock:
+            for entry in list(self._queue):
+                if entry[2].target == target:
+                    self._queue.remove(entry)
+                    self._finish(entry[2], CANCELLED)
+                    count += 1
+            heapq.heapify(self._queue)
+            for job in self._running:
+                if job.target == target and job.state == RUNNING:
+                    job.state = CANCELLED
+                    try:
+                        job._process.kill()
+                    except OSError:
+                        pass
+                    count += 1
+        return count
+
+    def wait_any(self, jobs: Iterable[Job], timeout: float = None) -> List[Job]:
+        """
+            The jobs done among these, waiting up to timeout for one if none is
+        """
+        jobs = list(jobs)
+        with self._lock:
+            self._lock.wait_for(lambda: any(job.done() for job in jobs), timeout)
+        return [job for job in jobs if job.done()]
+
+    def status(self) -> str:
+        with self._lock:
+            return f"{len(self._running)} running on {self._used}/{self.cores} cores, {len(self._queue)} queued"
+
+    def _dispatch(self):
+        # strict priority: the head of the queue waits for its cores, nothing overtakes it
+        while self._queue:
+            job = self._queue[0][2]
+            quota = min(job.threads or self.cores, self.cores)
+            if self._running and self._used + quota > self.cores:
+                break
+            heapq.heappop(self._queue)
+            job.quota = quota
+            job.state = RUNNING
+            job.time_start = timeit.default_timer()
+            self._used += quota
+            self._running.append(job)
+            try:
+                job._process = subprocess.Popen(job.command(), cwd=BIN_DIR, encoding="utf-8",
+                                                stdin=subprocess.PIPE if job.stdin is not None else None,
+                                                stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+            except OSError as e:
+                job._lines.append(str(e))
+                self._release(job)
+                self._finish(job, DONE)
+                continue
+            threading.Thread(target=self._run, args=(job,), daemon=True).start()
+
+    def _run(self, job: Job):
+        process = job._process
+        if job.stdin is not None:
+            try:
+                process.stdin.write(job.stdin)
+                process.stdin.close()
+            except OSError:
+                pass    # killed or died before reading it all
+        # joined once in _finish, the solvers can print megabytes of candidates
+        for line in process.stdout:
+            job._lines.append(line)
+            if job.on_line is not None and job.state == RUNNING:
+                job.on_line(line)
+        process.wait()
+        with self._lock:
+            job.returncode = process.returncode
+            self._release(job)
+            self._finish(job, CANCELLED if job.state == CANCELLED else DONE)
+            self._dispatch()
+
+    def _release(self, job: Job):
+        self._running.remove(job)
+        self._used -= job.quota
+
+    def _finish(self, job: Job, state: str):
+        job.state = state
+        job.output = "".join(job._lines)
+        job._lines = []
+        job.time_end = timeit.default_timer()
+        job._done.set()
+        self._lock.notify_all()
+
+
+_scheduler = None
+
+
+def scheduler() -> Scheduler:
+    """
+        The scheduler all the commands share, on every core
+    """
+    global _scheduler
+    if _scheduler is None:
+        _scheduler = Scheduler()
+    return _scheduler
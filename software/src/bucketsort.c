@@ -1,42 +1,137 @@
+#include <string.h>
 #include "bucketsort.h"
 
-extern void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
-                                  uint32_t *const ostart, uint32_t *const ostop,
-                                  bucket_info_t *bucket_info, bucket_array_t bucket) {
-    uint32_t *p1, *p2;
-    uint32_t *start[2];
-    uint32_t *stop[2];
+/** bucket_sort_inplace
+ * sort a list by its MSB without any bucket memory (American flag sort),
+ * bucket j then is start[bound[j]] .. start[bound[j + 1] - 1]
+ */
+void bucket_sort_inplace(uint32_t *const start, uint32_t *const stop, uint32_t bound[0x101]) {
+    uint32_t next[0x100];
+    uint32_t *p;
 
+    for (uint32_t j = 0x00; j <= 0x100; j++) {
+        bound[j] = 0;
+    }
+    for (p = start; p <= stop; p++) {
+        bound[(*p >> 24) + 1]++;
+    }
+    for (uint32_t j = 0x00; j <= 0xff; j++) {
+        bound[j + 1] += bound[j];
+        next[j] = bound[j];
+    }
+
+    // swap every entry into its bucket, each one is moved at most once
+    for (uint32_t j = 0x00; j <= 0xff; j++) {
+        while (next[j] < bound[j + 1]) {
+            uint32_t v = start[next[j]];
+            uint32_t b = v >> 24;
+            while (b != j) {
+                uint32_t t = start[next[b]];
+                start[next[b]++] = v;
+                v = t;
+                b = v >> 24;
+            }
+            start[next[j]++] = v;
+        }
+    }
+}
+
+#define SMALL_LIST 32
+
+static void insertion_sort_msb(uint32_t *const start, uint32_t *const stop) {
+    for (uint32_t *p1 = start + 1; p1 <= stop; p1++) {
+        uint32_t v = *p1, *p2;
+        for (p2 = p1; p2 > start && p2[-1] >> 24 > v >> 24; p2--) {
+            p2[0] = p2[-1];
+        }
+        *p2 = v;
+    }
+}
+
+// short lists: sort them and walk both, the 256 bucket loops would cost more
+static void intersect_small(uint32_t *const estart, uint32_t *const estop,
+                            uint32_t *const ostart, uint32_t *const ostop,
+                            bucket_info_t *bucket_info) {
+    uint32_t *e = estart, *o = ostart, *e_out = estart, *o_out = ostart;
+    uint32_t nonempty_bucket = 0;
+
+    insertion_sort_msb(estart, estop);
+    insertion_sort_msb(ostart, ostop);
+    while (e <= estop && o <= ostop) {
+        uint32_t be = *e >> 24, bo = *o >> 24;
+        if (be < bo) {
+            e++;
+        } else if (bo < be) {
+            o++;
+        } else {
+            bucket_info->bucket_info[0][nonempty_bucket].head = e_out;
+            for (; e <= estop && *e >> 24 == be; *e_out++ = *e++);
+            bucket_info->bucket_info[0][nonempty_bucket].tail = e_out - 1;
+            bucket_info->bucket_info[1][nonempty_bucket].head = o_out;
+            for (; o <= ostop && *o >> 24 == bo; *o_out++ = *o++);
+            bucket_info->bucket_info[1][nonempty_bucket].tail = o_out - 1;
+            nonempty_bucket++;
+        }
+    }
+    bucket_info->numbuckets = nonempty_bucket;
+}
+
+/** bucket_sort_intersect
+ * sort both lists by their MSB (contribution bits) and keep only the buckets
+ * found in both, packed from the start of each list in bucket order. Each
+ * list is counted, then scattered once into buf, which holds as many entries
+ * as the longest list, at offsets prefix summed over the intersecting buckets
+ * only. The entries of the other buckets all go to one trash slot past them,
+ * so the scatter has no branch.
+ * bucket_info gets the head and tail of every intersecting bucket.
+ */
+void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
+                           uint32_t *const ostart, uint32_t *const ostop,
+                           bucket_info_t *bucket_info, uint32_t *const buf) {
+    uint32_t count[2][0x100], pos[0x100], live[0x100];
+    uint32_t *start[2], *stop[2];
+
+    if (estop - estart < SMALL_LIST && ostop - ostart < SMALL_LIST) {
+        intersect_small(estart, estop, ostart, ostop, bucket_info);
+        return;
+    }
     start[0] = estart;
     stop[0] = estop;
     start[1] = ostart;
     stop[1] = ostop;
 
-    // init buckets to be empty
+    memset(count, 0, sizeof(count));
     for (uint32_t i = 0; i < 2; i++) {
-        for (uint32_t j = 0x00; j <= 0xff; j++) {
-            bucket[i][j].bp = bucket[i][j].head;
+        for (uint32_t *p = start[i]; p <= stop[i]; p++) {
+            count[i][*p >> 24]++;
         }
     }
+    for (uint32_t j = 0x00; j <= 0xff; j++) {
+        live[j] = (count[0][j] != 0) & (count[1][j] != 0);
+    }
 
-    // sort the lists into the buckets based on the MSB (contribution bits)
     for (uint32_t i = 0; i < 2; i++) {
-        for (p1 = start[i]; p1 <= stop[i]; p1++) {
-            uint32_t bucket_index = (*p1 & 0xff000000) >> 24;
-            *(bucket[i][bucket_index].bp++) = *p1;
+        uint32_t n = 0, nonempty_bucket = 0;
+        for (uint32_t j = 0x00; j <= 0xff; j++) {
+            pos[j] = n;
+            n += count[i][j] & -live[j];
         }
-    }
+        // n is the trash slot, within buf as long as some entry is dropped
+        for (uint32_t j = 0x00; j <= 0xff; j++) {
+            pos[j] = (pos[j] & -live[j]) | (n & (live[j] - 1));
+        }
+        for (uint32_t *p = start[i]; p <= stop[i]; p++) {
+            uint32_t b = *p >> 24;
+            buf[pos[b]] = *p;
+            pos[b] += live[b];
+        }
+        memcpy(start[i], buf, n * sizeof(uint32_t));
 
-    // write back intersecting buckets as sorted list.
-    // fill in bucket_info with head and tail of the bucket contents in the list and number of non-empty buckets.
-    for (uint32_t i = 0; i < 2; i++) {
-        p1 = start[i];
-        uint32_t nonempty_bucket = 0;
+        // pos[j] now is the end of bucket j
         for (uint32_t j = 0x00; j <= 0xff; j++) {
-            if (bucket[0][j].bp != bucket[0][j].head && bucket[1][j].bp != bucket[1][j].head) { // non-empty intersecting buckets only
-                bucket_info->bucket_info[i][nonempty_bucket].head = p1;
-                for (p2 = bucket[i][j].head; p2 < bucket[i][j].bp; *p1++ = *p2++);
-                bucket_info->bucket_info[i][nonempty_bucket].tail = p1 - 1;
+            if (live[j]) {
+                bucket_info->bucket_info[i][nonempty_bucket].head = start[i] + pos[j] - count[i][j];
+                bucket_info->bucket_info[i][nonempty_bucket].tail = start[i] + pos[j] - 1;
                 nonempty_bucket++;
             }
         }
@@ -5,13 +5,6 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-typedef struct bucket {
-    uint32_t *head;
-    uint32_t *bp;
-} bucket_t;
-
-typedef bucket_t bucket_array_t[2][0x100];
-
 typedef struct bucket_info {
     struct {
         uint32_t *head, *tail;
@@ -21,6 +14,7 @@ typedef struct bucket_info {
 
 void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
                            uint32_t *const ostart, uint32_t *const ostop,
-                           bucket_info_t *bucket_info, bucket_array_t bucket);
+                           bucket_info_t *bucket_info, uint32_t *const buf);
+void bucket_sort_inplace(uint32_t *const start, uint32_t *const stop, uint32_t bound[0x101]);
 
 #endif
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+#define CAPTURE_HEADER_SIZE 26
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+// payload bytes a reader needs of each record type, 0 = unknown type
+static uint32_t payload_size(uint8_t type) {
+    switch (type) {
+        case CAPTURE_HARDNESTED:
+            return 8;
+        case CAPTURE_NESTED:
+            return 16;
+        case CAPTURE_STATIC_NESTED:
+        case CAPTURE_STATIC_ENC_NESTED:
+            return 12;
+        case CAPTURE_DARKSIDE:
+            return 32;
+        case CAPTURE_AUTH:
+            return 20;
+        default:
+            return 0;
+    }
+}
+
+static void parse_record(uint8_t type, const uint8_t *p, CaptureRecord *r) {
+    memset(r, 0, sizeof(CaptureRecord));
+    r->type = type;
+    r->block = p[0];
+    r->key = p[1];
+    switch (type) {
+        case CAPTURE_NESTED:
+            r->par = p[2];
+            r->dist = get_u32(p + 4);
+            r->nt = get_u32(p + 8);
+            r->nt_enc = get_u32(p + 12);
+            break;
+        case CAPTURE_STATIC_NESTED:
+            r->flags = p[2];
+            r->nt = get_u32(p + 4);
+            r->nt_enc = get_u32(p + 8);
+            break;
+        case CAPTURE_STATIC_ENC_NESTED:
+            r->nt = get_u32(p + 4);
+            r->nt_enc = get_u32(p + 8);
+            break;
+        case CAPTURE_DARKSIDE:
+            r->nt = get_u32(p + 4);
+            r->nr = get_u32(p + 8);
+            r->ar = get_u32(p + 12);
+            r->par_list = get_u64(p + 16);
+            r->ks_list = get_u64(p + 24);
+            break;
+        case CAPTURE_AUTH:
+            r->uid = get_u32(p + 4);
+            r->nt = get_u32(p + 8);
+            r->nr = get_u32(p + 12);
+            r->ar = get_u32(p + 16);
+            break;
+        case CAPTURE_HARDNESTED:
+            r->par = p[2];
+            r->nt_enc = get_u32(p + 4);
+            break;
+    }
+}
+
+// the reverse of parse_record, payload_size(r->type) bytes
+static void pack_record(const CaptureRecord *r, uint8_t *p) {
+    memset(p, 0, payload_size(r->type));
+    p[0] = r->block;
+    p[1] = r->key;
+    switch (r->type) {
+        case CAPTURE_NESTED:
+            p[2] = r->par;
+            put_u32(p + 4, r->dist);
+            put_u32(p + 8, r->nt);
+            put_u32(p + 12, r->nt_enc);
+            break;
+        case CAPTURE_STATIC_NESTED:
+            p[2] = r->flags;
+            put_u32(p + 4, r->nt);
+            put_u32(p + 8, r->nt_enc);
+            break;
+        case CAPTURE_STATIC_ENC_NESTED:
+            put_u32(p + 4, r->nt);
+            put_u32(p + 8, r->nt_enc);
+            break;
+        case CAPTURE_DARKSIDE:
+            put_u32(p + 4, r->nt);
+            put_u32(p + 8, r->nr);
+            put_u32(p + 12, r->ar);
+            put_u64(p + 16, r->par_list);
+            put_u64(p + 24, r->ks_list);
+            break;
+        case CAPTURE_AUTH:
+            put_u32(p + 4, r->uid);
+            put_u32(p + 8, r->nt);
+            put_u32(p + 12, r->nr);
+            put_u32(p + 16, r->ar);
+            break;
+        case CAPTURE_HARDNESTED:
+            p[2] = r->par;
+            put_u32(p + 4, r->nt_enc);
+            break;
+    }
+}
+
+int capture_read(const char *path, CaptureHeader *header, CaptureRecord **records, uint32_t *count) {
+    uint8_t head[CAPTURE_HEADER_SIZE];
+    uint8_t payload[0x100];
+    int type, size;
+
+    *records = NULL;
+    *count = 0;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) || memcmp(head, CAPTURE_MAGIC, 4) != 0) {
+        fclose(f);
+        return 0;
+    }
+    if (head[4] > CAPTURE_VERSION || head[5] < CAPTURE_HEADER_SIZE) {
+        fclose(f);
+        return -1;
+    }
+    header->version = head[4];
+    header->prng = head[6];
+    header->sak = head[7];
+    memcpy(header->atqa, head + 8, 2);
+    header->uid_len = head[10] <= sizeof(header->uid) ? head[10] : sizeof(header->uid);
+    memcpy(header->uid, head + 12, sizeof(header->uid));
+    header->auth_uid = get_u32(head + 22);
+    if (fseek(f, head[5], SEEK_SET) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    while ((type = fgetc(f)) != EOF && (size = fgetc(f)) != EOF) {
+        if (fread(payload, 1, size, f) != (size_t)size) {
+            break;
+        }
+        uint32_t need = payload_size((uint8_t)type);
+        if (need == 0 || (uint32_t)size < need) {
+            continue;
+        }
+        void *tmp = realloc(*records, sizeof(CaptureRecord) * (*count + 1));
+        if (tmp == NULL) {
+            free(*records);
+            *records = NULL;
+            *count = 0;
+            fclose(f);
+            return -1;
+        }
+        *records = tmp;
+        parse_record((uint8_t)type, payload, &(*records)[(*count)++]);
+    }
+    fclose(f);
+    return 1;
+}
+
+bool capture_write(const char *path, const CaptureHeader *header, const CaptureRecord *records, uint32_t count) {
+    uint8_t head[CAPTURE_HEADER_SIZE] = CAPTURE_MAGIC;
+    uint8_t record[0x100];
+    bool ok;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    head[4] = CAPTURE_VERSION;
+    head[5] = CAPTURE_HEADER_SIZE;
+    head[6] = header->prng;
+    head[7] = header->sak;
+    memcpy(head + 8, header->atqa, 2);
+    head[10] = header->uid_len;
+    memcpy(head + 12, header->uid, sizeof(header->uid));
+    put_u32(head + 22, header->auth_uid);
+    ok = fwrite(head, 1, sizeof(head), f) == sizeof(head);
+
+    for (uint32_t i = 0; ok && i < count; i++) {
+        uint32_t size = payload_size(records[i].type);
+        if (size == 0) {
+            continue;
+        }
+        record[0] = records[i].type;
+        record[1] = (uint8_t)size;
+        pack_record(&records[i], record + 2);
+        ok = fwrite(record, 1, size + 2, f) == size + 2;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+char capture_key_type(const CaptureRecord *r) {
+    return (r->key & 1) ? 'B' : 'A';
+}
+
+bool capture_same_target(const CaptureRecord *a, const CaptureRecord *b) {
+    return a->type == b->type && a->block == b->block && (a->key & 1) == (b->key & 1);
+}
+
+bool capture_first_of_target(const CaptureRecord *records, uint32_t i) {
+    for (uint32_t j = 0; j < i; j++) {
+        if (capture_same_target(&records[j], &records[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t capture_target_count(const CaptureRecord *records, uint32_t count, uint8_t type) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].type == type && capture_first_of_target(records, i)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+uint32_t capture_run_start(const CaptureRecord *records, uint32_t i, uint32_t *n) {
+    uint32_t start = i;
+    *n = 0;
+    for (uint32_t j = i; j-- > 0 && !(records[start].flags & CAPTURE_RUN_START);) {
+        if (capture_same_target(&records[j], &records[i])) {
+            start = j;
+            (*n)++;
+        }
+    }
+    return start;
+}
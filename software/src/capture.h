@@ -0,0 +1,97 @@
+#ifndef CAPTURE_H__
+#define CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Nonce capture files, written by the CLI while it acquires nonces and read
+ * back by the solvers. All values little endian, the file is append only:
+ *
+ *   header   "CUNC" version:u8 header_size:u8 prng:u8 sak:u8 atqa:2 uid_len:u8 rfu:u8
+ *            uid:10 auth_uid:u32
+ *   records  type:u8 size:u8 payload[size]
+ *
+ * Readers skip header bytes and record types they don't know and ignore
+ * trailing bytes of a known payload, newer writers may only add to them.
+ */
+#define CAPTURE_MAGIC           "CUNC"
+#define CAPTURE_VERSION         1
+
+#define CAPTURE_PRNG_STATIC     0
+#define CAPTURE_PRNG_WEAK       1
+#define CAPTURE_PRNG_HARD       2
+#define CAPTURE_PRNG_UNKNOWN    0xFF
+
+// record types and payloads, `key` bit 0 is set for key B
+enum {
+    CAPTURE_NESTED = 1,         // block key par rfu dist:u32 nt:u32 nt_enc:u32
+    CAPTURE_STATIC_NESTED = 2,  // block key flags rfu nt:u32 nt_enc:u32
+    CAPTURE_DARKSIDE = 3,       // block key rfu:2 nt:u32 nr:u32 ar:u32 par_list:u64 ks_list:u64
+    CAPTURE_AUTH = 4,           // block key rfu:2 uid:u32 nt:u32 nr:u32 ar:u32, bit 1 of key: nested auth
+    CAPTURE_STATIC_ENC_NESTED = 5,  // block key rfu:2 nt:u32 nt_enc:u32, nt of the known key auth
+    CAPTURE_HARDNESTED = 6,     // block key par rfu nt_enc:u32, bit b of par: byte b of {nt}
+};
+
+// flags of the static nested records
+#define CAPTURE_RUN_START       0x01    // first nonce of an acquisition, the distance starts over
+
+typedef struct {
+    uint8_t version;
+    uint8_t prng;       // CAPTURE_PRNG_*
+    uint8_t sak;
+    uint8_t atqa[2];
+    uint8_t uid_len;
+    uint8_t uid[10];
+    uint32_t auth_uid;  // uid used in the card authentications
+} CaptureHeader;
+
+typedef struct {
+    uint8_t type;
+    uint8_t block;
+    uint8_t key;
+    uint8_t par;
+    uint8_t flags;      // CAPTURE_RUN_START...
+    uint32_t uid;       // auth records only
+    uint32_t dist;
+    uint32_t nt;
+    uint32_t nt_enc;
+    uint32_t nr;
+    uint32_t ar;
+    uint64_t par_list;
+    uint64_t ks_list;
+} CaptureRecord;
+
+/** capture_read
+ * load a capture file, records of unknown types are dropped and a record
+ * cut short at the end of the file (interrupted write) is ignored.
+ * Returns 1 and a malloc'd record list on success, 0 if the file isn't a
+ * capture file, -1 if it can't be read or is of a newer version.
+ */
+int capture_read(const char *path, CaptureHeader *header, CaptureRecord **records, uint32_t *count);
+
+/** capture_write
+ * write a new capture file, replacing any file at path. Returns false if it
+ * can't be written.
+ */
+bool capture_write(const char *path, const CaptureHeader *header, const CaptureRecord *records, uint32_t count);
+
+// `key` character of a record, 'A' or 'B'
+char capture_key_type(const CaptureRecord *r);
+
+/** capture_first_of_target
+ * true if records[i] is the first one of its type for its block and key,
+ * the solvers run once per such target
+ */
+bool capture_first_of_target(const CaptureRecord *records, uint32_t i);
+bool capture_same_target(const CaptureRecord *a, const CaptureRecord *b);
+uint32_t capture_target_count(const CaptureRecord *records, uint32_t count, uint8_t type);
+
+/** capture_run_start
+ * index of the first record of the acquisition records[i] is part of, the
+ * one flagged CAPTURE_RUN_START or else the first of its target (files
+ * written before the flag), and in *n the place of records[i] in it
+ */
+uint32_t capture_run_start(const CaptureRecord *records, uint32_t i, uint32_t *n);
+
+#endif
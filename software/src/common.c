@@ -1,4 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <stdint.h>
+#include "common.h"
+#include "crapto1.h"
+
+#if WIN32
+#include "windows.h"
+#else
+#include "unistd.h"
+#endif
 
 
 uint64_t atoui(const char *str) {
@@ -18,3 +30,112 @@ void num_to_bytes(uint64_t n, uint32_t len, uint8_t *dest) {
         n >>= 8;
     }
 }
+
+// number of online cpus, at least 1
+uint32_t get_cpu_count(void) {
+#if WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+#endif
+}
+
+// append a key to a growing list, false if out of memory
+static bool append_key(uint64_t **keys, uint32_t *count, uint32_t *size, uint64_t key) {
+    if (*count == *size) {
+        uint32_t grow = *size ? *size * 2 : 1024;
+        void *tmp = realloc(*keys, grow * sizeof(uint64_t));
+        if (tmp == NULL) {
+            return false;
+        }
+        *keys = tmp;
+        *size = grow;
+    }
+    (*keys)[(*count)++] = key;
+    return true;
+}
+
+bool load_dictionary(const char *path, uint64_t **keys, uint32_t *count, uint32_t *size) {
+    char line[256];
+    bool ok = true;
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+
+    if (f == NULL) {
+        return false;
+    }
+    while (ok && fgets(line, sizeof(line), f)) {
+        char *p = line;
+        int i;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        for (i = 0; i < 12 && isxdigit((unsigned char)p[i]); i++);
+        if (i < 12 || isxdigit((unsigned char)p[12])) {
+            continue;   // comment, blank or not a key
+        }
+        p[12] = '\0';
+        ok = append_key(keys, count, size, strtoull(p, NULL, 16));
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+    return ok;
+}
+
+/** parse_tool_options
+ * options go in front of the positional arguments:
+ *   -t, --threads <n>   number of worker threads, 0 = one per online cpu
+ *   -a, --all           every candidate key with its count, not only the best ones
+ *   --isa <name>        instruction set of the recovery kernels (scalar, sse2, avx2, avx512...)
+ *   -m, --memory <MB>   cap of the recovery tables of all threads together,
+ *                       fewer threads are run if each would get too little
+ *   -c, --cache <file>  candidates of the earlier runs on the same card, the keys
+ *                       of this run are checked against them and added
+ *   -s, --stream        print the likely keys as they come up, before the final ones
+ * returns the index of the first positional argument, -1 on a bad option
+ */
+int parse_tool_options(int argc, char *const argv[], ToolOptions *opts) {
+    uint64_t memory = 0;
+    int i;
+
+    memset(opts, 0, sizeof(ToolOptions));
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            opts->threads = (uint32_t)atoui(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--all") == 0) {
+            opts->all_keys = true;
+        } else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache") == 0) && i + 1 < argc) {
+            opts->cache = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stream") == 0) {
+            opts->stream = true;
+        } else if ((strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--memory") == 0) && i + 1 < argc) {
+            memory = atoui(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+            if (!crapto1_set_isa(argv[++i])) {
+                printf("Instruction set %s not available (this cpu runs %s), stopping\n", argv[i], crapto1_isa());
+                return -1;
+            }
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    if (memory) {
+        uint64_t least = lfsr_recovery_min_limit();
+        uint32_t threads = opts->threads ? opts->threads : get_cpu_count();
+        if (memory < least) {
+            printf("--memory needs at least %u MB\n", (uint32_t)((least + (1 << 20) - 1) >> 20));
+            return -1;
+        }
+        if (memory / threads < least) {
+            threads = (uint32_t)(memory / least);
+            opts->threads = threads;
+        }
+        lfsr_recovery_set_limit((size_t)(memory / threads));
+    }
+    return i;
+}
@@ -1,7 +1,27 @@
 #ifndef COMMON_H__
 #define COMMON_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
 uint64_t atoui(const char *str);
 void num_to_bytes(uint64_t n, uint32_t len, uint8_t *dest);
+uint32_t get_cpu_count(void);
+
+/** load_dictionary
+ * append the keys of a .dic file to a growing list, `size` is its capacity.
+ * One 12 hex digit key per line, # starts a comment, "-" reads stdin.
+ * Returns false if it can't be read or out of memory.
+ */
+bool load_dictionary(const char *path, uint64_t **keys, uint32_t *count, uint32_t *size);
+
+typedef struct {
+    uint32_t threads;   // 0 = one per online cpu
+    bool all_keys;      // print every candidate, for the solvers ranking keys
+    const char *cache;  // candidate file carried over between runs, NULL = none
+    bool stream;        // print provisional candidates while solving
+} ToolOptions;
+
+int parse_tool_options(int argc, char *const argv[], ToolOptions *opts);
 
 #endif
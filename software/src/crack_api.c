@@ -0,0 +1,137 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// chameleon_crack shared library
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+
+#include "crack_api.h"
+#include "nested_util.h"
+#include "mfkey.h"
+
+struct ChameleonDarksideSession {
+    DarksideSolver solver;
+};
+
+static void to_darkside_param(DarksideParam *dp, const ChameleonDarksideNonce *nonce) {
+    dp->nt = nonce->nt;
+    dp->nr = nonce->nr;
+    dp->ar = nonce->ar;
+    dp->par_list = nonce->par_list;
+    dp->ks_list = nonce->ks_list;
+}
+
+uint32_t chameleon_crack_version(void) {
+    return CHAMELEON_CRACK_VERSION;
+}
+
+void chameleon_crack_free(void *keys) {
+    free(keys);
+}
+
+static int32_t run_nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t uid, uint32_t threads, uint64_t **keys) {
+    uint32_t keyCount = 0;
+
+    *keys = nested(pNK, sizePNK, uid, threads, &keyCount);
+    free(pNK);
+    return (int32_t)keyCount;
+}
+
+int32_t chameleon_crack_nested(uint32_t uid, uint32_t dist,
+                               const ChameleonNestedNonce *nonces, uint32_t count,
+                               uint32_t threads, uint64_t **keys) {
+    NtpKs1 *pNK = NULL;
+    uint32_t i, sizePNK = 0;
+
+    *keys = NULL;
+    for (i = 0; i < count; i++) {
+        if (!nested_add_nonce(&pNK, &sizePNK, nonces[i].nt, nonces[i].nt_enc, (uint8_t)nonces[i].par, dist)) {
+            free(pNK);
+            return -1;
+        }
+    }
+    return run_nested(pNK, sizePNK, uid, threads, keys);
+}
+
+int32_t chameleon_crack_staticnested(uint32_t uid, uint32_t key_type,
+                                     const ChameleonStaticNestedNonce *nonces, uint32_t count,
+                                     uint32_t threads, uint64_t **keys) {
+    NtpKs1 *pNK = NULL;
+    uint32_t i, dist, sizePNK = 0;
+
+    *keys = NULL;
+    if (count == 0 || !staticnested_dist(nonces[0].nt, (uint8_t)key_type, &dist)) {
+        return -1;
+    }
+    for (i = 0; i < count; i++, dist += 160) {
+        if (!staticnested_add_nonce(&pNK, &sizePNK, nonces[i].nt, nonces[i].nt_enc, dist)) {
+            free(pNK);
+            return -1;
+        }
+    }
+    return run_nested(pNK, sizePNK, uid, threads, keys);
+}
+
+int32_t chameleon_crack_darkside(uint32_t uid, const ChameleonDarksideNonce *nonces,
+                                 uint32_t count, uint64_t **keys) {
+    uint32_t i, keyCount = 0;
+    DarksideParam *dps = calloc(count ? count : 1, sizeof(DarksideParam));
+
+    *keys = NULL;
+    if (dps == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        to_darkside_param(&dps[i], &nonces[i]);
+    }
+    *keys = darkside_recover(uid, dps, count, 0, &keyCount);
+    free(dps);
+    return (int32_t)keyCount;
+}
+
+ChameleonDarksideSession *chameleon_crack_darkside_begin(uint32_t uid) {
+    ChameleonDarksideSession *session = malloc(sizeof(ChameleonDarksideSession));
+
+    if (session != NULL) {
+        darkside_solver_init(&session->solver, uid);
+    }
+    return session;
+}
+
+int32_t chameleon_crack_darkside_add(ChameleonDarksideSession *session,
+                                     const ChameleonDarksideNonce *nonce, uint64_t **keys) {
+    DarksideParam dp;
+
+    *keys = NULL;
+    if (session == NULL) {
+        return -1;
+    }
+    to_darkside_param(&dp, nonce);
+    return (int32_t)darkside_solver_add(&session->solver, &dp, keys);
+}
+
+void chameleon_crack_darkside_end(ChameleonDarksideSession *session) {
+    if (session != NULL) {
+        darkside_solver_free(&session->solver);
+        free(session);
+    }
+}
+
+int32_t chameleon_crack_mfkey32(uint32_t uid, uint32_t nt,
+                                uint32_t nr0_enc, uint32_t ar0_enc,
+                                uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key) {
+    return mfkey32(uid, nt, nr0_enc, ar0_enc, nr1_enc, ar1_enc, key) ? 1 : 0;
+}
+
+int32_t chameleon_crack_mfkey32v2(uint32_t uid,
+                                  uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+                                  uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key) {
+    return mfkey32v2(uid, nt0, nr0_enc, ar0_enc, nt1, nr1_enc, ar1_enc, key) ? 1 : 0;
+}
+
+int32_t chameleon_crack_mfkey64(uint32_t uid, uint32_t nt, uint32_t nr_enc,
+                                uint32_t ar_enc, uint32_t at_enc, uint64_t *key) {
+    return mfkey64(uid, nt, nr_enc, ar_enc, at_enc, key) ? 1 : 0;
+}
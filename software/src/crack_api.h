@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// C interface of the chameleon_crack shared library, the same solvers as the
+// command line tools without process start and text parsing per call.
+//
+// All structs only have 32/64 bit fields so that their layout is the same for
+// every compiler. Functions returning a key list allocate it, it must be
+// released with chameleon_crack_free().
+//-----------------------------------------------------------------------------
+
+#ifndef CRACK_API_H__
+#define CRACK_API_H__
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define CHAMELEON_CRACK_API __declspec(dllexport)
+#else
+#define CHAMELEON_CRACK_API __attribute__((visibility("default")))
+#endif
+
+#define CHAMELEON_CRACK_VERSION 2
+
+typedef struct {
+    uint32_t nt;        // plain tag nonce of the known key auth
+    uint32_t nt_enc;    // encrypted tag nonce of the nested auth
+    uint32_t par;       // parity bits of nt_enc, bit 0 for the first byte
+} ChameleonNestedNonce;
+
+typedef struct {
+    uint32_t nt;
+    uint32_t nt_enc;
+} ChameleonStaticNestedNonce;
+
+typedef struct {
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+    uint32_t reserved;
+    uint64_t par_list;
+    uint64_t ks_list;
+} ChameleonDarksideNonce;
+
+CHAMELEON_CRACK_API uint32_t chameleon_crack_version(void);
+CHAMELEON_CRACK_API void chameleon_crack_free(void *keys);
+
+// Candidate keys of a nested/staticnested attack, most likely first.
+// Return the number of keys in *keys, -1 on bad input or out of memory.
+CHAMELEON_CRACK_API int32_t chameleon_crack_nested(uint32_t uid, uint32_t dist,
+                                                   const ChameleonNestedNonce *nonces, uint32_t count,
+                                                   uint32_t threads, uint64_t **keys);
+CHAMELEON_CRACK_API int32_t chameleon_crack_staticnested(uint32_t uid, uint32_t key_type,
+                                                         const ChameleonStaticNestedNonce *nonces, uint32_t count,
+                                                         uint32_t threads, uint64_t **keys);
+
+// Candidate keys of a darkside attack, 0 if more nonces are needed.
+CHAMELEON_CRACK_API int32_t chameleon_crack_darkside(uint32_t uid, const ChameleonDarksideNonce *nonces,
+                                                     uint32_t count, uint64_t **keys);
+
+// Darkside across retries, every nonce added is solved once and intersected
+// with the candidates of the previous ones. add returns the number of keys
+// given by that nonce, 0 if more nonces are needed, -1 on error.
+typedef struct ChameleonDarksideSession ChameleonDarksideSession;
+CHAMELEON_CRACK_API ChameleonDarksideSession *chameleon_crack_darkside_begin(uint32_t uid);
+CHAMELEON_CRACK_API int32_t chameleon_crack_darkside_add(ChameleonDarksideSession *session,
+                                                         const ChameleonDarksideNonce *nonce, uint64_t **keys);
+CHAMELEON_CRACK_API void chameleon_crack_darkside_end(ChameleonDarksideSession *session);
+
+// Return 1 and set *key if it was found, 0 otherwise.
+CHAMELEON_CRACK_API int32_t chameleon_crack_mfkey32(uint32_t uid, uint32_t nt,
+                                                    uint32_t nr0_enc, uint32_t ar0_enc,
+                                                    uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key);
+CHAMELEON_CRACK_API int32_t chameleon_crack_mfkey32v2(uint32_t uid,
+                                                      uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+                                                      uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key);
+CHAMELEON_CRACK_API int32_t chameleon_crack_mfkey64(uint32_t uid, uint32_t nt, uint32_t nr_enc,
+                                                    uint32_t ar_enc, uint32_t at_enc, uint64_t *key);
+
+#endif
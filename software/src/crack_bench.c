@@ -0,0 +1,452 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Micro benchmarks of the crypto1 and solver primitives
+//
+//     crack_bench [-r <repeats>] [--isa <name>] [-m <MB>] [name...]
+//
+// Fixtures come from a fixed seed, every run times the same work. Each
+// benchmark is run once to warm up, then `repeats` times; the median and the
+// best ns/op are reported as JSON on stdout. `check` is a hash of the results,
+// it must not change between two commits unless the results do, `stable` is
+// false if it changed between the runs.
+//-----------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crapto1.h"
+#include "parity.h"
+#include "bucketsort.h"
+#include "mfkey.h"
+#include "nested_util.h"
+#include "common.h"
+
+#if WIN32
+#include "windows.h"
+#else
+#include <time.h>
+#endif
+
+#define DEFAULT_REPEATS     5
+#define MAX_REPEATS         101
+#define SORT_LIST_SIZE      (1 << 18)
+#define RANK_LIST_SIZE      (1 << 20)
+
+typedef struct {
+    const char *name;
+    uint32_t ops;                                   // operations of one run
+    uint64_t (*run)(uint32_t ops, uint64_t *ns);    // adds the timed part to ns, returns the check hash
+} Bench;
+
+static uint64_t seed;
+
+static void reseed(void) {
+    seed = 0x43484d4c45304e55ULL;
+}
+
+static uint32_t rand32(void) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(seed >> 32);
+}
+
+static uint64_t rand48(void) {
+    return ((uint64_t)rand32() << 16 ^ rand32()) & 0xFFFFFFFFFFFFULL;
+}
+
+static uint64_t hash(uint64_t h, uint64_t v) {
+    return (h ^ v) * 1099511628211ULL;
+}
+
+static uint64_t now_ns(void) {
+#if WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart * 1e9 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// hash of a zero terminated state list, independent of its order
+static uint64_t hash_states(const struct Crypto1State *s) {
+    uint64_t h = 0, n = 0;
+    for (; s->odd | s->even; s++, n++) {
+        h += hash(hash(1469598103934665603ULL, s->odd), s->even);
+    }
+    return hash(h, n);
+}
+
+static uint64_t bench_recovery32(uint32_t ops, uint64_t *ns) {
+    uint64_t h = 1469598103934665603ULL;
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t ks2 = rand32(), in = (i & 1) ? rand32() : 0;
+        uint64_t t = now_ns();
+        struct Crypto1State *s = lfsr_recovery32(ks2, in);
+        *ns += now_ns() - t;
+        if (s != NULL) {
+            h = hash(h, hash_states(s));
+        }
+        free(s);
+    }
+    return h;
+}
+
+static uint64_t bench_recovery32_ctx(uint32_t ops, uint64_t *ns) {
+    uint64_t h = 1469598103934665603ULL;
+    struct Crypto1Recovery *ctx = lfsr_recovery_create();
+    if (ctx == NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t ks2 = rand32(), in = (i & 1) ? rand32() : 0;
+        uint64_t t = now_ns();
+        struct Crypto1State *s = lfsr_recovery32_ctx(ctx, ks2, in);
+        *ns += now_ns() - t;
+        h = hash(h, hash_states(s));
+    }
+    lfsr_recovery_destroy(ctx);
+    return h;
+}
+
+// keystream words 2 and 3 of a real authentication, one state is found
+static uint64_t bench_recovery64(uint32_t ops, uint64_t *ns) {
+    uint64_t h = 1469598103934665603ULL;
+    for (uint32_t i = 0; i < ops; i++) {
+        struct Crypto1State c;
+        crypto1_init(&c, rand48());
+        crypto1_word(&c, rand32(), 0);
+        crypto1_word(&c, rand32(), 0);
+        uint32_t ks2 = crypto1_word(&c, 0, 0);
+        uint32_t ks3 = crypto1_word(&c, 0, 0);
+        uint64_t t = now_ns();
+        struct Crypto1State *s = lfsr_recovery64(ks2, ks3);
+        *ns += now_ns() - t;
+        h = hash(h, s->odd);
+        h = hash(h, s->even);
+        free(s);
+    }
+    return h;
+}
+
+#define STATE_COUNT 1024
+
+static void random_states(struct Crypto1State *s, uint32_t *in) {
+    for (uint32_t i = 0; i < STATE_COUNT; i++) {
+        s[i].odd = rand32() & 0xFFFFFF;
+        s[i].even = rand32() & 0xFFFFFF;
+        in[i] = rand32();
+    }
+}
+
+static uint64_t bench_rollback_word(uint32_t ops, uint64_t *ns) {
+    struct Crypto1State s[STATE_COUNT];
+    uint32_t in[STATE_COUNT];
+    uint64_t h = 1469598103934665603ULL;
+
+    random_states(s, in);
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        h += lfsr_rollback_word(&s[i % STATE_COUNT], in[i % STATE_COUNT], i & 1);
+    }
+    *ns += now_ns() - t;
+    for (uint32_t i = 0; i < STATE_COUNT; i++) {
+        h = hash(hash(h, s[i].odd), s[i].even);
+    }
+    return h;
+}
+
+static uint64_t bench_get_lfsr(uint32_t ops, uint64_t *ns) {
+    struct Crypto1State s[STATE_COUNT];
+    uint32_t in[STATE_COUNT];
+    uint64_t h = 1469598103934665603ULL, key;
+
+    random_states(s, in);
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        // feed the key back so the calls can't be merged
+        s[i % STATE_COUNT].odd ^= (uint32_t)h & 1;
+        crypto1_get_lfsr(&s[i % STATE_COUNT], &key);
+        h += key;
+    }
+    *ns += now_ns() - t;
+    return h;
+}
+
+// same work as bench_rollback_word, through the batched call
+static uint64_t bench_rollback_words(uint32_t ops, uint64_t *ns) {
+    struct Crypto1State s[STATE_COUNT];
+    uint32_t in[STATE_COUNT];
+    uint64_t h = 1469598103934665603ULL;
+
+    random_states(s, in);
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < ops; i += STATE_COUNT) {
+        lfsr_rollback_words(s, STATE_COUNT, in[i / STATE_COUNT % STATE_COUNT], i / STATE_COUNT & 1);
+    }
+    *ns += now_ns() - t;
+    for (uint32_t i = 0; i < STATE_COUNT; i++) {
+        h = hash(hash(h, s[i].odd), s[i].even);
+    }
+    return h;
+}
+
+static uint64_t bench_get_lfsrs(uint32_t ops, uint64_t *ns) {
+    struct Crypto1State s[STATE_COUNT];
+    uint32_t in[STATE_COUNT];
+    uint64_t keys[STATE_COUNT];
+    uint64_t h = 1469598103934665603ULL;
+
+    random_states(s, in);
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < ops; i += STATE_COUNT) {
+        s[i / STATE_COUNT % STATE_COUNT].odd ^= (uint32_t)h & 1;
+        crypto1_get_lfsrs(s, STATE_COUNT, keys);
+        h += keys[i / STATE_COUNT % STATE_COUNT];
+    }
+    *ns += now_ns() - t;
+    return h;
+}
+
+// 64 steps, the distance of {ar} in every authentication
+static uint64_t bench_prng_successor(uint32_t ops, uint64_t *ns) {
+    uint32_t x = rand32();
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        x = prng_successor(x, 64);
+    }
+    *ns += now_ns() - t;
+    return x;
+}
+
+// the even and odd lists of one recovery extension step, timed without the copy
+static uint64_t bench_bucket_sort(uint32_t ops, uint64_t *ns) {
+    uint32_t *fixture = malloc(sizeof(uint32_t) * SORT_LIST_SIZE * 2);
+    uint32_t *lists = malloc(sizeof(uint32_t) * SORT_LIST_SIZE * 2);
+    uint32_t *buf = malloc(sizeof(uint32_t) * SORT_LIST_SIZE);
+    bucket_info_t *info = malloc(sizeof(bucket_info_t));
+    uint64_t h = 1469598103934665603ULL;
+
+    if (fixture == NULL || lists == NULL || buf == NULL || info == NULL) {
+        goto done;
+    }
+    for (uint32_t i = 0; i < SORT_LIST_SIZE * 2; i++) {
+        fixture[i] = rand32();
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        memcpy(lists, fixture, sizeof(uint32_t) * SORT_LIST_SIZE * 2);
+        uint64_t t = now_ns();
+        bucket_sort_intersect(lists, lists + SORT_LIST_SIZE - 1, lists + SORT_LIST_SIZE,
+                              lists + SORT_LIST_SIZE * 2 - 1, info, buf);
+        *ns += now_ns() - t;
+        h = hash(h, info->numbuckets);
+        h = hash(h, *info->bucket_info[0][info->numbuckets - 1].tail);
+    }
+done:
+    free(fixture);
+    free(lists);
+    free(buf);
+    free(info);
+    return h;
+}
+
+// one darkside nonce of a random key, as the firmware collects it
+static uint64_t bench_nonce2key(uint32_t ops, uint64_t *ns) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (uint32_t k = 0; k < ops; k++) {
+        uint64_t key = rand48(), ks_info = 0, par_info = 0, *keys;
+        uint32_t uid = rand32(), nt = rand32(), nr = rand32() & 0xFFFFFF1F, ar = rand32();
+
+        for (uint32_t c = 0; c < 8; c++) {
+            struct Crypto1State s;
+            crypto1_init(&s, key);
+            crypto1_word(&s, uid ^ nt, 0);
+            uint32_t nr_c = nr | c << 5;
+            uint32_t ks1 = crypto1_word(&s, nr_c, 1);
+            uint32_t ks2 = crypto1_word(&s, 0, 0);
+            uint8_t nib = 0, par = 0;
+            for (uint32_t j = 0; j < 4; j++) {
+                nib |= crypto1_bit(&s, 0, 0) << j;
+            }
+            uint32_t np = nr_c ^ ks1, ap = ar ^ ks2;
+            uint8_t ks_bits[8] = { BIT(ks1, 16), BIT(ks1, 8), BIT(ks1, 0), BIT(ks2, 24), BIT(ks2, 16), BIT(ks2, 8),
+                                   BIT(ks2, 0), nib & 1
+                                 };
+            for (uint32_t j = 0; j < 8; j++) {
+                uint8_t byte = j < 4 ? np >> (24 - 8 * j) : ap >> (24 - 8 * (j - 4));
+                par |= (oddparity8(byte) ^ ks_bits[j]) << j;
+            }
+            ks_info |= (uint64_t)nib << (8 * (7 - c));
+            par_info |= (uint64_t)par << (8 * (7 - c));
+        }
+        uint64_t t = now_ns();
+        uint32_t n = nonce2key(uid, nt, nr, ar, par_info, ks_info, 0, &keys);
+        *ns += now_ns() - t;
+        h = hash(h, n);
+        for (uint32_t i = 0; i < n; i++) {
+            h += keys[i] == key;
+        }
+        free(keys);
+    }
+    return h;
+}
+
+// two reader authentications of a random key
+static uint64_t bench_mfkey32v2(uint32_t ops, uint64_t *ns) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (uint32_t k = 0; k < ops; k++) {
+        uint64_t key = rand48(), found = 0;
+        uint32_t uid = rand32(), nt[2], nr_enc[2], ar_enc[2];
+
+        for (uint32_t i = 0; i < 2; i++) {
+            struct Crypto1State s;
+            uint32_t nr = rand32();
+            nt[i] = rand32();
+            crypto1_init(&s, key);
+            crypto1_word(&s, uid ^ nt[i], 0);
+            nr_enc[i] = nr ^ crypto1_word(&s, nr, 0);
+            ar_enc[i] = prng_successor(nt[i], 64) ^ crypto1_word(&s, 0, 0);
+        }
+        uint64_t t = now_ns();
+        bool ok = mfkey32v2(uid, nt[0], nr_enc[0], ar_enc[0], nt[1], nr_enc[1], ar_enc[1], &found);
+        *ns += now_ns() - t;
+        h = hash(h, ok && found == key);
+    }
+    return h;
+}
+
+// the candidates of a nested attack, one key in four found twice
+static uint64_t bench_rank_keys(uint32_t ops, uint64_t *ns) {
+    uint64_t *fixture = malloc(sizeof(uint64_t) * RANK_LIST_SIZE);
+    uint64_t *keys = malloc(sizeof(uint64_t) * RANK_LIST_SIZE);
+    uint64_t h = 1469598103934665603ULL;
+    uint32_t count;
+
+    if (fixture != NULL && keys != NULL) {
+        for (uint32_t i = 0; i < RANK_LIST_SIZE; i++) {
+            fixture[i] = (i & 3) == 3 ? fixture[rand32() % i] : rand48();
+        }
+        for (uint32_t i = 0; i < ops; i++) {
+            memcpy(keys, fixture, sizeof(uint64_t) * RANK_LIST_SIZE);
+            uint64_t t = now_ns();
+            countKeys *ck = rank_keys(keys, RANK_LIST_SIZE, 50, &count);
+            *ns += now_ns() - t;
+            for (uint32_t j = 0; ck != NULL && j < count; j++) {
+                h = hash(hash(h, ck[j].key), ck[j].count);
+            }
+            free(ck);
+        }
+    }
+    free(fixture);
+    free(keys);
+    return h;
+}
+
+static const Bench benches[] = {
+    { "lfsr_recovery32",        8,          bench_recovery32 },
+    { "lfsr_recovery32_ctx",    8,          bench_recovery32_ctx },
+    { "lfsr_recovery64",        4,          bench_recovery64 },
+    { "lfsr_rollback_word",     1 << 22,    bench_rollback_word },
+    { "crypto1_get_lfsr",       1 << 22,    bench_get_lfsr },
+    { "lfsr_rollback_words",    1 << 22,    bench_rollback_words },
+    { "crypto1_get_lfsrs",      1 << 22,    bench_get_lfsrs },
+    { "prng_successor",         1 << 20,    bench_prng_successor },
+    { "bucket_sort_intersect",  32,         bench_bucket_sort },
+    { "nonce2key",              2,          bench_nonce2key },
+    { "mfkey32v2",              8,          bench_mfkey32v2 },
+    { "rank_keys",              8,          bench_rank_keys },
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static bool selected(const char *name, int argc, char *argv[], int argi) {
+    if (argi == argc) {
+        return true;
+    }
+    for (int i = argi; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t repeats = DEFAULT_REPEATS;
+    double ns_per_op[MAX_REPEATS];
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-r") == 0 && argi + 1 < argc) {
+            repeats = (uint32_t)atoui(argv[++argi]);
+        } else if (strcmp(argv[argi], "--isa") == 0 && argi + 1 < argc) {
+            if (!crapto1_set_isa(argv[++argi])) {
+                printf("instruction set %s not available\n", argv[argi]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[argi], "-m") == 0 && argi + 1 < argc) {
+            if (!lfsr_recovery_set_limit((size_t)atoui(argv[++argi]) << 20)) {
+                printf("-m needs at least %u MB\n", (uint32_t)((lfsr_recovery_min_limit() + (1 << 20) - 1) >> 20));
+                return EXIT_FAILURE;
+            }
+        } else {
+            break;
+        }
+    }
+    if (argi < argc && argv[argi][0] == '-') {
+        printf("syntax: %s [-r <repeats>] [--isa <name>] [-m <MB>] [benchmark...]\n", argv[0]);
+        printf("  benchmarks:");
+        for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+            printf(" %s", benches[i].name);
+        }
+        printf("\n");
+        return EXIT_FAILURE;
+    }
+    if (repeats < 1 || repeats > MAX_REPEATS) {
+        repeats = DEFAULT_REPEATS;
+    }
+
+    printf("{\n  \"isa\": \"%s\",\n  \"repeats\": %u,\n  \"benchmarks\": [", crapto1_isa(), repeats);
+    bool first = true;
+    for (uint32_t b = 0; b < BENCH_COUNT; b++) {
+        const Bench *bench = &benches[b];
+        uint64_t ns = 0, check;
+        bool stable = true;
+
+        if (!selected(bench->name, argc, argv, argi)) {
+            continue;
+        }
+        // warm up: page in the tables and let the clock settle
+        reseed();
+        check = bench->run(bench->ops, &ns);
+        for (uint32_t r = 0; r < repeats; r++) {
+            ns = 0;
+            reseed();
+            stable &= bench->run(bench->ops, &ns) == check;
+            ns_per_op[r] = (double)ns / bench->ops;
+        }
+        qsort(ns_per_op, repeats, sizeof(double), compare_double);
+        double median = ns_per_op[repeats / 2];
+        printf("%s\n    {\"name\": \"%s\", \"ops\": %u, \"ns_per_op\": %.1f, \"min_ns_per_op\": %.1f, "
+               "\"ops_per_sec\": %.1f, \"check\": \"%016" PRIx64 "\", \"stable\": %s}",
+               first ? "" : ",", bench->name, bench->ops, median, ns_per_op[0],
+               median > 0 ? 1e9 / median : 0.0, check, stable ? "true" : "false");
+        fflush(stdout);
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+    return EXIT_SUCCESS;
+}
@@ -22,8 +22,16 @@
 
 #include "crapto1.h"
 #include "bucketsort.h"
+#include <string.h>
+#ifdef CRAPTO1_SIMD
+#include "crapto1_simd.h"
+#endif
 
-#if !defined LOWMEM && defined __GNUC__
+#if defined CRAPTO1_FILTERLUT
+// const table generated at build time by filterlut_gen.c
+extern const uint8_t filterlut[1 << 20];
+#define filter(x) (filterlut[(x) & 0xfffff])
+#elif !defined LOWMEM && defined __GNUC__
 static uint8_t filterlut[1 << 20];
 static void __attribute__((constructor)) fill_lut(void) {
     uint32_t i;
@@ -80,12 +88,14 @@ static inline void extend_table_simple(uint32_t *tbl, uint32_t **end, int bit) {
     }
 }
 /** recover
- * recursively narrow down the search space, 4 bits of keystream at a time
+ * recursively narrow down the search space, 4 bits of keystream at a time.
+ * scratch holds as many entries as the longest list, the extensions bounce
+ * through it and the bucket sort scatters into it.
  */
 static struct Crypto1State *
 recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         uint32_t *e_head, uint32_t *e_tail, uint32_t eks, int rem,
-        struct Crypto1State *sl, uint32_t in, bucket_array_t bucket) {
+        struct Crypto1State *sl, uint32_t in, uint32_t *scratch) {
     bucket_info_t bucket_info;
 
     if (rem == -1) {
@@ -100,6 +110,38 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         return sl;
     }
 
+#ifdef CRAPTO1_SIMD
+    // extend out of place, bouncing between the table and the scratch area
+    int steps = rem < 4 ? rem : 4;
+    rem = rem < 4 ? -1 : rem - 4;
+    size_t o_n = o_tail - o_head + 1, e_n = e_tail - e_head + 1;
+    uint32_t *src = o_head, *dst = scratch, *t;
+
+    for (int i = 1; i <= steps && o_n; i++) {
+        o_n = extend_table_simd(dst, src, o_n, oks >> i & 1, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0);
+        t = src, src = dst, dst = t;
+    }
+    if (!o_n)
+        return sl;
+    if (src != o_head)
+        memcpy(o_head, src, o_n * sizeof(uint32_t));
+    o_tail = o_head + o_n - 1;
+
+    src = e_head, dst = scratch;
+    for (int i = 1; i <= steps && e_n; i++) {
+        e_n = extend_table_simd(dst, src, e_n, eks >> i & 1, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in >> 2 * i & 3);
+        t = src, src = dst, dst = t;
+    }
+    if (!e_n)
+        return sl;
+    if (src != e_head)
+        memcpy(e_head, src, e_n * sizeof(uint32_t));
+    e_tail = e_head + e_n - 1;
+
+    oks >>= steps;
+    eks >>= steps;
+    in >>= 2 * steps;
+#else
     for (uint32_t i = 0; i < 4 && rem--; i++) {
         oks >>= 1;
         eks >>= 1;
@@ -112,13 +154,14 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         if (e_head > e_tail)
             return sl;
     }
+#endif
 
-    bucket_sort_intersect(e_head, e_tail, o_head, o_tail, &bucket_info, bucket);
+    bucket_sort_intersect(e_head, e_tail, o_head, o_tail, &bucket_info, scratch);
 
     for (int i = bucket_info.numbuckets - 1; i >= 0; i--) {
         sl = recover(bucket_info.bucket_info[1][i].head, bucket_info.bucket_info[1][i].tail, oks,
                      bucket_info.bucket_info[0][i].head, bucket_info.bucket_info[0][i].tail, eks,
-                     rem, sl, in, bucket);
+                     rem, sl, in, scratch);
     }
 
     return sl;
@@ -126,15 +169,276 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
 
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
-/** lfsr_recovery
+struct Crypto1Recovery {
+    uint32_t *odd;
+    uint32_t *even;
+    uint32_t *scratch;
+    struct Crypto1State *statelist;
+
+    // bounded mode, 0 slices for the full tables
+    uint32_t slices;
+    size_t table_cap, build_cap, work_cap;
+};
+
+#define RECOVERY_STATES         ((1 << 20) + 1)
+#define RECOVERY_BUILD_STATES   (1 << 15)
+#define RECOVERY_MAX_SLICES     64      // tables of 4 buckets at least
+
+// bytes per context, 0 = full tables
+static size_t recovery_limit;
+
+// the tables of the full mode
+static size_t recovery_size_full(void) {
+    return sizeof(struct Crypto1Recovery) + (sizeof(struct Crypto1State) << 18) + 3 * (sizeof(uint32_t) << 21);
+}
+
+/** recovery_size_bounded
+ * fill in the table sizes of the bounded mode for ctx->slices. About half of
+ * the initial states are left after the first nine keystream bits, at most
+ * twice that while they are extended. A slice holds 1 / slices of them.
+ */
+static size_t recovery_size_bounded(struct Crypto1Recovery *ctx) {
+    size_t states = RECOVERY_STATES / 2 / ctx->slices;
+
+    ctx->table_cap = states + states / 4 + 1024;
+    ctx->build_cap = RECOVERY_BUILD_STATES + RECOVERY_BUILD_STATES / 4 + 256;
+    ctx->work_cap = 1 << 14;
+    return sizeof(struct Crypto1Recovery) + (sizeof(struct Crypto1State) << 18) +
+           sizeof(uint32_t) * (2 * ctx->table_cap + 2 * ctx->build_cap + 3 * ctx->work_cap);
+}
+
+/** lfsr_recovery_set_limit
+ * cap the memory of every context made by lfsr_recovery_create (and
+ * lfsr_recovery32), 0 for no cap. Below the full tables the states are
+ * recovered in slices, one after the other.
+ * Returns false if the limit is below lfsr_recovery_min_limit()
+ */
+bool lfsr_recovery_set_limit(size_t bytes) {
+    if (bytes != 0 && bytes < lfsr_recovery_min_limit())
+        return false;
+    recovery_limit = bytes;
+    return true;
+}
+
+size_t lfsr_recovery_min_limit(void) {
+    struct Crypto1Recovery plan;
+
+    plan.slices = RECOVERY_MAX_SLICES;
+    return recovery_size_bounded(&plan);
+}
+
+static struct Crypto1Recovery *lfsr_recovery_create_bounded(size_t limit) {
+    struct Crypto1Recovery *ctx = calloc(1, sizeof(struct Crypto1Recovery));
+    if (!ctx)
+        return 0;
+
+    // fewest slices fitting, each one costs building the tables again
+    for (ctx->slices = 1; recovery_size_bounded(ctx) > limit; ctx->slices++) {
+        if (ctx->slices == RECOVERY_MAX_SLICES) {
+            free(ctx);
+            return 0;
+        }
+    }
+    ctx->odd = malloc(sizeof(uint32_t) * ctx->table_cap);
+    ctx->even = malloc(sizeof(uint32_t) * ctx->table_cap);
+    // build area, then the work area of recover_buckets()
+    ctx->scratch = malloc(sizeof(uint32_t) * (2 * ctx->build_cap + 3 * ctx->work_cap));
+    ctx->statelist = malloc(sizeof(struct Crypto1State) << 18);
+    if (!ctx->odd || !ctx->even || !ctx->scratch || !ctx->statelist) {
+        lfsr_recovery_destroy(ctx);
+        return 0;
+    }
+    return ctx;
+}
+
+/** lfsr_recovery_create
+ * allocate the tables used by lfsr_recovery32_ctx once, so that a thread
+ * recovering many keystreams does not go through the allocator every time
+ */
+struct Crypto1Recovery *lfsr_recovery_create(void) {
+    if (recovery_limit && recovery_limit < recovery_size_full())
+        return lfsr_recovery_create_bounded(recovery_limit);
+
+    struct Crypto1Recovery *ctx = calloc(1, sizeof(struct Crypto1Recovery));
+    if (!ctx)
+        return 0;
+
+    ctx->odd = malloc(sizeof(uint32_t) << 21);
+    ctx->even = malloc(sizeof(uint32_t) << 21);
+    // the extensions and the bucket sort work in it, as large as a table
+    ctx->scratch = malloc(sizeof(uint32_t) << 21);
+    ctx->statelist = malloc(sizeof(struct Crypto1State) << 18);
+    if (!ctx->odd || !ctx->even || !ctx->scratch || !ctx->statelist) {
+        lfsr_recovery_destroy(ctx);
+        return 0;
+    }
+    return ctx;
+}
+
+void lfsr_recovery_destroy(struct Crypto1Recovery *ctx) {
+    if (!ctx)
+        return;
+    free(ctx->odd);
+    free(ctx->even);
+    free(ctx->scratch);
+    free(ctx->statelist);
+    free(ctx);
+}
+
+/** build_slice
+ * table of the states start .. start + count - 1 giving the first nine
+ * keystream bits of ks, the last four extensions being the ones at the top of
+ * recover(). a and b hold cap entries each, the table ends up in *tbl.
+ * Returns false if cap is too small for the slice.
+ */
+static bool build_slice(uint32_t **tbl, size_t *n, uint32_t *a, uint32_t *b, size_t cap,
+                        uint32_t start, uint32_t count, uint32_t ks, uint32_t m1, uint32_t m2, uint32_t in) {
+    int i;
+
+    if (count > cap)
+        return false;
+#ifdef CRAPTO1_SIMD
+    uint32_t *t;
+
+    *n = filter_select_simd(a, start, count, ks & 1);
+    for (i = 1; i <= 8 && *n; i++) {
+        if (*n > cap / 2)
+            return false;
+        if (i <= 4)
+            *n = extend_table_simple_simd(b, a, *n, ks >> i & 1);
+        else
+            *n = extend_table_simd(b, a, *n, ks >> i & 1, m1, m2, in >> 2 * (i - 4) & 3);
+        t = a, a = b, b = t;
+    }
+#else
+    uint32_t *tail = a - 1;
+    (void)b;
+
+    for (uint32_t x = start; x < start + count; x++)
+        if (filter(x) == (ks & 1))
+            *++tail = x;
+    for (i = 1; i <= 8 && tail >= a; i++) {
+        if ((size_t)(tail - a + 1) > cap / 2)
+            return false;
+        if (i <= 4)
+            extend_table_simple(a, &tail, ks >> i & 1);
+        else
+            extend_table(a, &tail, ks >> i & 1, m1, m2, in >> 2 * (i - 4) & 3);
+    }
+    *n = tail - a + 1;
+#endif
+    *tbl = a;
+    return true;
+}
+
+/** collect_slice
+ * the states of the first nine keystream bits whose contribution bits, the
+ * top byte, are first .. last - 1. Built a piece at a time in the build area.
+ * Returns false if they don't fit in tbl.
+ */
+static bool collect_slice(struct Crypto1Recovery *ctx, uint32_t *tbl, size_t *n, uint32_t first, uint32_t last,
+                          uint32_t ks, uint32_t m1, uint32_t m2, uint32_t in) {
+    uint32_t *build = ctx->scratch, *piece;
+    uint32_t start = 0, count = RECOVERY_STATES;
+    size_t m;
+
+    *n = 0;
+    while (count) {
+        uint32_t c = count < RECOVERY_BUILD_STATES ? count : RECOVERY_BUILD_STATES;
+        // a piece growing past the build area is cut in half
+        while (!build_slice(&piece, &m, build, build + ctx->build_cap, ctx->build_cap, start, c, ks, m1, m2, in))
+            c /= 2;
+        for (size_t i = 0; i < m; i++) {
+            if (piece[i] >> 24 >= first && piece[i] >> 24 < last) {
+                if (*n == ctx->table_cap)
+                    return false;
+                tbl[(*n)++] = piece[i];
+            }
+        }
+        start += c;
+        count -= c;
+    }
+    return true;
+}
+
+/** recover_buckets
+ * recover() below the first intersection, for the buckets of a sorted odd and
+ * even table. The buckets are copied to the work area, in parts small enough
+ * to leave it the room recover() grows them into: all the states of a bucket
+ * pair are still found, part against part.
+ */
+static struct Crypto1State *
+recover_buckets(struct Crypto1Recovery *ctx, const uint32_t *o_bound, const uint32_t *e_bound,
+                uint32_t oks, uint32_t eks, uint32_t in, struct Crypto1State *sl) {
+    uint32_t *o_work = ctx->scratch + 2 * ctx->build_cap;
+    uint32_t *e_work = o_work + ctx->work_cap, *scratch = e_work + ctx->work_cap;
+    size_t part = ctx->work_cap / 4;
+
+    for (int j = 0xff; j >= 0; j--) {
+        size_t o_n = o_bound[j + 1] - o_bound[j], e_n = e_bound[j + 1] - e_bound[j];
+        for (size_t o = 0; o < o_n; o += part) {
+            size_t o_part = o_n - o < part ? o_n - o : part;
+            for (size_t e = 0; e < e_n; e += part) {
+                size_t e_part = e_n - e < part ? e_n - e : part;
+                memcpy(o_work, ctx->odd + o_bound[j] + o, o_part * sizeof(uint32_t));
+                memcpy(e_work, ctx->even + e_bound[j] + e, e_part * sizeof(uint32_t));
+                sl = recover(o_work, o_work + o_part - 1, oks, e_work, e_work + e_part - 1, eks,
+                             7, sl, in, scratch);
+            }
+        }
+    }
+    return sl;
+}
+
+// the odd and even states of the buckets first .. last - 1, halved if too many
+static struct Crypto1State *
+recover_slice(struct Crypto1Recovery *ctx, uint32_t first, uint32_t last,
+              uint32_t oks, uint32_t eks, uint32_t in, struct Crypto1State *sl) {
+    uint32_t o_bound[0x101], e_bound[0x101];
+    size_t o_n, e_n;
+
+    if (!collect_slice(ctx, ctx->odd, &o_n, first, last, oks, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0) ||
+            !collect_slice(ctx, ctx->even, &e_n, first, last, eks, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in)) {
+        // a single bucket is a fraction of the smallest table, see RECOVERY_MAX_SLICES
+        if (last - first < 2)
+            return sl;
+        sl = recover_slice(ctx, first, (first + last) / 2, oks, eks, in, sl);
+        return recover_slice(ctx, (first + last) / 2, last, oks, eks, in, sl);
+    }
+    if (!o_n || !e_n)
+        return sl;
+    bucket_sort_inplace(ctx->odd, ctx->odd + o_n - 1, o_bound);
+    bucket_sort_inplace(ctx->even, ctx->even + e_n - 1, e_bound);
+    return recover_buckets(ctx, o_bound, e_bound, oks >> 8, eks >> 8, in >> 8, sl);
+}
+
+/** lfsr_recovery32_bounded
+ * lfsr_recovery32_ctx in the tables of a bounded context. Below the first
+ * intersection only odd and even states of the same bucket meet, so the
+ * buckets are cut in slices and the odd and even tables of each slice built
+ * and recovered one after the other.
+ */
+static struct Crypto1State *lfsr_recovery32_bounded(struct Crypto1Recovery *ctx, uint32_t oks, uint32_t eks, uint32_t in) {
+    struct Crypto1State *sl = ctx->statelist;
+
+    sl->odd = sl->even = 0;
+    for (uint32_t i = 0; i < ctx->slices; i++)
+        sl = recover_slice(ctx, 0x100 * i / ctx->slices, 0x100 * (i + 1) / ctx->slices, oks, eks, in, sl);
+    return ctx->statelist;
+}
+
+/** lfsr_recovery32_ctx
  * recover the state of the lfsr given 32 bits of the keystream
  * additionally you can use the in parameter to specify the value
  * that was fed into the lfsr at the time the keystream was generated
+ * The zero terminated list returned is owned by ctx and only valid until
+ * its next use.
  */
-struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
-    struct Crypto1State *statelist;
-    uint32_t *odd_head = 0, *odd_tail = 0, oks = 0;
-    uint32_t *even_head = 0, *even_tail = 0, eks = 0;
+struct Crypto1State *lfsr_recovery32_ctx(struct Crypto1Recovery *ctx, uint32_t ks2, uint32_t in) {
+    struct Crypto1State *statelist = ctx->statelist;
+    uint32_t *odd_head = ctx->odd, *odd_tail = ctx->odd - 1, oks = 0;
+    uint32_t *even_head = ctx->even, *even_tail = ctx->even - 1, eks = 0;
+    uint32_t *scratch = ctx->scratch;
     int i;
 
     // split the keystream into an odd and even part
@@ -143,29 +447,29 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     for (i = 30; i >= 0; i -= 2)
         eks = eks << 1 | BEBIT(ks2, i);
 
-    odd_head = odd_tail = malloc(sizeof(uint32_t) << 21);
-    even_head = even_tail = malloc(sizeof(uint32_t) << 21);
-    statelist =  malloc(sizeof(struct Crypto1State) << 18);
-    if (!odd_tail-- || !even_tail-- || !statelist) {
-        free(statelist);
-        statelist = 0;
-        goto out;
+    if (ctx->slices) {
+        in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00);
+        return lfsr_recovery32_bounded(ctx, oks, eks, in << 1);
     }
 
     statelist->odd = statelist->even = 0;
 
-    // allocate memory for out of place bucket_sort
-    bucket_array_t bucket;
-
-    for (i = 0; i < 2; i++) {
-        for (uint32_t j = 0; j <= 0xff; j++) {
-            bucket[i][j].head = malloc(sizeof(uint32_t) << 14);
-            if (!bucket[i][j].head) {
-                goto out;
-            }
-        }
+#ifdef CRAPTO1_SIMD
+    // same as below, but through the vectorized kernels. Four extensions
+    // leave the tables back in place.
+    size_t odd_n = filter_select_simd(odd_head, 0, (1 << 20) + 1, oks & 1);
+    size_t even_n = filter_select_simd(even_head, 0, (1 << 20) + 1, eks & 1);
+    for (i = 0; i < 4; i += 2) {
+        odd_n = extend_table_simple_simd(scratch, odd_head, odd_n, (oks >>= 1) & 1);
+        odd_n = extend_table_simple_simd(odd_head, scratch, odd_n, (oks >>= 1) & 1);
     }
-
+    for (i = 0; i < 4; i += 2) {
+        even_n = extend_table_simple_simd(scratch, even_head, even_n, (eks >>= 1) & 1);
+        even_n = extend_table_simple_simd(even_head, scratch, even_n, (eks >>= 1) & 1);
+    }
+    odd_tail = odd_head + odd_n - 1;
+    even_tail = even_head + even_n - 1;
+#else
     // initialize statelists: add all possible states which would result into the rightmost 2 bits of the keystream
     for (i = 1 << 20; i >= 0; --i) {
         if (filter(i) == (oks & 1))
@@ -179,19 +483,40 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
         extend_table_simple(odd_head,  &odd_tail, (oks >>= 1) & 1);
         extend_table_simple(even_head, &even_tail, (eks >>= 1) & 1);
     }
+#endif
 
     // the statelists now contain all states which could have generated the last 10 Bits of the keystream.
     // 22 bits to go to recover 32 bits in total. From now on, we need to take the "in"
     // parameter into account.
     in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00); // Byte swapping
-    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket);
+    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, scratch);
 
-out:
-    for (i = 0; i < 2; i++)
-        for (uint32_t j = 0; j <= 0xff; j++)
-            free(bucket[i][j].head);
-    free(odd_head);
-    free(even_head);
+    return statelist;
+}
+
+#ifndef CRAPTO1_SIMD
+// the vector kernels are not built, see crapto1_dispatch.c
+const char *crapto1_isa(void) {
+    return "scalar";
+}
+
+bool crapto1_set_isa(const char *name) {
+    return strcmp(name, "scalar") == 0;
+}
+#endif
+
+/** lfsr_recovery
+ * one shot lfsr_recovery32_ctx, the list returned is to be freed by the caller
+ */
+struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
+    struct Crypto1State *statelist = 0;
+    struct Crypto1Recovery *ctx = lfsr_recovery_create();
+
+    if (ctx) {
+        statelist = lfsr_recovery32_ctx(ctx, ks2, in);
+        ctx->statelist = 0;
+        lfsr_recovery_destroy(ctx);
+    }
     return statelist;
 }
 
@@ -371,6 +696,20 @@ uint32_t lfsr_rollback_word(struct Crypto1State *s, uint32_t in, int fb) {
     return ret;
 }
 
+/** lfsr_rollback_words
+ * lfsr_rollback_word on an array of states, the keystream is dropped.
+ * Bitsliced over SIMD lanes when built with CRAPTO1_SIMD.
+ */
+void lfsr_rollback_words(struct Crypto1State *s, size_t n, uint32_t in, int fb) {
+#ifdef CRAPTO1_SIMD
+    lfsr_rollback_words_simd(s, n, in, fb);
+#else
+    for (size_t i = 0; i < n; i++) {
+        lfsr_rollback_word(s + i, in, fb);
+    }
+#endif
+}
+
 /** nonce_distance
  * x,y valid tag nonces, then prng_successor(x, nonce_distance(x, y)) = y
  */
@@ -472,6 +811,28 @@ static struct Crypto1State *check_pfx_parity(uint32_t prefix, uint32_t rresp, ui
     return sl + good;
 }
 
+/** lfsr_common_prefix_odd
+ * the common prefix attack for a single odd half of lfsr_prefix_ks(), so that
+ * callers can split it up. Appends the states found to sl, which needs room for
+ * 64 states per even half, and returns the end of the list.
+ * The top 3 bits of both halves run over their 64 combinations.
+ */
+struct Crypto1State *lfsr_common_prefix_odd(uint32_t pfx, uint32_t rr, uint8_t par[8][8], uint32_t no_par,
+                                            uint32_t odd, const uint32_t *even, struct Crypto1State *sl) {
+    uint32_t o, e, top;
+
+    for (; *even + 1; ++even) {
+        o = odd;
+        e = *even;
+        for (top = 0; top < 64; ++top) {
+            o += 1 << 21;
+            e += (!(top & 7) + 1) << 21;
+            sl = check_pfx_parity(pfx, rr, par, o, e, sl, no_par);
+        }
+    }
+    return sl;
+}
+
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
 /** lfsr_common_prefix
  * Implentation of the common prefix attack.
@@ -485,7 +846,7 @@ static struct Crypto1State *check_pfx_parity(uint32_t prefix, uint32_t rresp, ui
 
 struct Crypto1State *lfsr_common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8], uint8_t par[8][8], uint32_t no_par) {
     struct Crypto1State *statelist, *s;
-    uint32_t *odd, *even, *o, *e, top;
+    uint32_t *odd, *even, *o;
 
     odd = lfsr_prefix_ks(ks, 1);
     even = lfsr_prefix_ks(ks, 0);
@@ -498,12 +859,7 @@ struct Crypto1State *lfsr_common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8]
     }
 
     for (o = odd; *o + 1; ++o)
-        for (e = even; *e + 1; ++e)
-            for (top = 0; top < 64; ++top) {
-                *o += 1 << 21;
-                *e += (!(top & 7) + 1) << 21;
-                s = check_pfx_parity(pfx, rr, par, *o, *e, s, no_par);
-            }
+        s = lfsr_common_prefix_odd(pfx, rr, par, no_par, *o, even, s);
 
     s->odd = s->even = 0;
 out:
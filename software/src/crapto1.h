@@ -32,6 +32,7 @@ struct Crypto1State *crypto1_create(uint64_t key);
 void crypto1_destroy(struct Crypto1State *);
 #endif
 void crypto1_get_lfsr(struct Crypto1State *, uint64_t *);
+void crypto1_get_lfsrs(const struct Crypto1State *states, size_t n, uint64_t *lfsr);
 uint8_t crypto1_bit(struct Crypto1State *, uint8_t, int);
 uint8_t crypto1_byte(struct Crypto1State *, uint8_t, int);
 uint32_t crypto1_word(struct Crypto1State *, uint32_t, int);
@@ -39,16 +40,30 @@ uint32_t prng_successor(uint32_t x, uint32_t n);
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
 struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in);
+// instruction set of the lfsr_recovery32 kernels, "scalar" without CRAPTO1_SIMD
+const char *crapto1_isa(void);
+bool crapto1_set_isa(const char *name);
+// reusable tables for lfsr_recovery32, one per thread
+struct Crypto1Recovery;
+struct Crypto1Recovery *lfsr_recovery_create(void);
+void lfsr_recovery_destroy(struct Crypto1Recovery *ctx);
+struct Crypto1State *lfsr_recovery32_ctx(struct Crypto1Recovery *ctx, uint32_t ks2, uint32_t in);
+// memory cap of the contexts above, in bytes per context, 0 for no cap
+bool lfsr_recovery_set_limit(size_t bytes);
+size_t lfsr_recovery_min_limit(void);
 struct Crypto1State *lfsr_recovery64(uint32_t ks2, uint32_t ks3);
 struct Crypto1State *
 lfsr_common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8], uint8_t par[8][8], uint32_t no_par);
 #endif
 uint32_t *lfsr_prefix_ks(uint8_t ks[8], int isodd);
+struct Crypto1State *lfsr_common_prefix_odd(uint32_t pfx, uint32_t rr, uint8_t par[8][8], uint32_t no_par,
+                                            uint32_t odd, const uint32_t *even, struct Crypto1State *sl);
 
 
 uint8_t lfsr_rollback_bit(struct Crypto1State *s, uint32_t in, int fb);
 uint8_t lfsr_rollback_byte(struct Crypto1State *s, uint32_t in, int fb);
 uint32_t lfsr_rollback_word(struct Crypto1State *s, uint32_t in, int fb);
+void lfsr_rollback_words(struct Crypto1State *s, size_t n, uint32_t in, int fb);
 int nonce_distance(uint32_t from, uint32_t to);
 bool validate_prng_nonce(uint32_t nonce);
 #define FOREACH_VALID_NONCE(N, FILTER, FSIZE)\
@@ -0,0 +1,162 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Run time choice of the crapto1_simd.c build used by lfsr_recovery32
+//
+// With CRAPTO1_SIMD_DISPATCH (x86-64) the kernels are built for SSE2, AVX2
+// and AVX-512, the best one the cpu runs is chosen once at start. Otherwise
+// there is the single build made for the target flags. The plain filter and
+// table extension code is always there as "scalar", for comparison.
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "parity.h"
+#include "crapto1.h"
+#include "crapto1_simd.h"
+
+typedef struct {
+    const char *name;
+    int (*supported)(void);
+    size_t (*filter_select)(uint32_t *out, uint32_t start, uint32_t count, int bit);
+    size_t (*extend_table_simple)(uint32_t *out, const uint32_t *in, size_t n, int bit);
+    size_t (*extend_table)(uint32_t *out, const uint32_t *in, size_t n, int bit,
+                           uint32_t m1, uint32_t m2, uint32_t in_bits);
+    void (*rollback_words)(struct Crypto1State *s, size_t n, uint32_t in, int fb);
+} SimdKernels;
+
+#define SIMD_KERNELS(isa, supported) { \
+        KERNEL_ISA(crapto1_simd_name, isa), supported, KERNEL_ISA(filter_select_simd, isa), \
+        KERNEL_ISA(extend_table_simple_simd, isa), KERNEL_ISA(extend_table_simd, isa), \
+        KERNEL_ISA(lfsr_rollback_words_simd, isa) \
+    }
+
+static int always(void) {
+    return 1;
+}
+
+// the kernels one state at a time, same output as the vector ones
+static size_t filter_select_scalar(uint32_t *out, uint32_t start, uint32_t count, int bit) {
+    size_t o = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        out[o] = start + i;
+        o += filter(start + i) == bit;
+    }
+    return o;
+}
+
+static size_t extend_table_simple_scalar(uint32_t *out, const uint32_t *in, size_t n, int bit) {
+    size_t o = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        for (uint32_t k = 0; k < 2; k++) {
+            out[o] = in[i] << 1 | k;
+            o += filter(out[o]) == bit;
+        }
+    }
+    return o;
+}
+
+static size_t extend_table_scalar(uint32_t *out, const uint32_t *in, size_t n, int bit,
+                                  uint32_t m1, uint32_t m2, uint32_t in_bits) {
+    size_t o = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        for (uint32_t k = 0; k < 2; k++) {
+            uint32_t v = in[i] << 1 | k;
+            if (filter(v) != bit)
+                continue;
+            uint32_t p = (v >> 25) << 2 | evenparity32(v & m1) << 1 | evenparity32(v & m2);
+            out[o++] = (p << 24 | (v & 0xffffff)) ^ in_bits << 24;
+        }
+    }
+    return o;
+}
+
+static void lfsr_rollback_words_scalar(struct Crypto1State *s, size_t n, uint32_t in, int fb) {
+    for (size_t i = 0; i < n; i++)
+        lfsr_rollback_word(&s[i], in, fb);
+}
+
+#define SCALAR_KERNELS { \
+        "scalar", always, filter_select_scalar, extend_table_simple_scalar, extend_table_scalar, \
+        lfsr_rollback_words_scalar \
+    }
+
+#ifdef CRAPTO1_SIMD_DISPATCH
+DECLARE_SIMD_KERNELS(sse2)
+DECLARE_SIMD_KERNELS(avx2)
+DECLARE_SIMD_KERNELS(avx512)
+
+static int has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int has_avx512(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+
+// worst to best
+static SimdKernels kernels[] = {
+    SCALAR_KERNELS,
+    SIMD_KERNELS(sse2, always),
+    SIMD_KERNELS(avx2, has_avx2),
+    SIMD_KERNELS(avx512, has_avx512),
+};
+#else
+DECLARE_SIMD_KERNELS(native)
+
+static SimdKernels kernels[] = {
+    SCALAR_KERNELS,
+    SIMD_KERNELS(native, always),
+};
+#endif
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static const SimdKernels *active = &kernels[0];
+
+static void __attribute__((constructor)) select_kernels(void) {
+#ifdef CRAPTO1_SIMD_DISPATCH
+    __builtin_cpu_init();
+#endif
+    for (size_t i = 0; i < KERNEL_COUNT; i++)
+        if (kernels[i].supported())
+            active = &kernels[i];
+}
+
+const char *crapto1_isa(void) {
+    return active->name;
+}
+
+/** crapto1_set_isa
+ * use the kernels of another instruction set, before any recovery starts.
+ * Returns false if they weren't built or the cpu lacks the instructions.
+ */
+bool crapto1_set_isa(const char *name) {
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        if (strcmp(kernels[i].name, name) == 0 && kernels[i].supported()) {
+            active = &kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t filter_select_simd(uint32_t *out, uint32_t start, uint32_t count, int bit) {
+    return active->filter_select(out, start, count, bit);
+}
+
+size_t extend_table_simple_simd(uint32_t *out, const uint32_t *in, size_t n, int bit) {
+    return active->extend_table_simple(out, in, n, bit);
+}
+
+size_t extend_table_simd(uint32_t *out, const uint32_t *in, size_t n, int bit,
+                         uint32_t m1, uint32_t m2, uint32_t in_bits) {
+    return active->extend_table(out, in, n, bit, m1, m2, in_bits);
+}
+
+void lfsr_rollback_words_simd(struct Crypto1State *s, size_t n, uint32_t in, int fb) {
+    active->rollback_words(s, n, in, fb);
+}
@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Vectorized filter and table extension kernels used by lfsr_recovery32,
+// and the batched rollback of the states it returns
+//
+// Written with the GCC/Clang generic vector extension, so the same source
+// turns into SSE2, AVX2, AVX-512 or NEON code depending on the target flags.
+// CMakeLists.txt builds it once per instruction set, CRAPTO1_SIMD_ISA
+// suffixing the names, and crapto1_dispatch.c picks one at run time.
+// The scalar in-place code in crapto1.c is the reference.
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "crapto1.h"
+#include "crapto1_simd.h"
+#include "crypto1_bs.h"
+
+#ifndef CRAPTO1_SIMD_ISA
+#define CRAPTO1_SIMD_ISA native
+#endif
+#define KERNEL(name) KERNEL_ISA(name, CRAPTO1_SIMD_ISA)
+
+#if defined(__AVX512F__)
+#define LANES 16
+#define ISA_NAME "avx512"
+#elif defined(__AVX2__)
+#define LANES 8
+#define ISA_NAME "avx2"
+#else
+#define LANES 4
+#if defined(__SSE2__)
+#define ISA_NAME "sse2"
+#elif defined(__ARM_NEON)
+#define ISA_NAME "neon"
+#else
+#define ISA_NAME "generic"
+#endif
+#endif
+
+const char KERNEL(crapto1_simd_name)[] = ISA_NAME;
+typedef uint32_t vec_t __attribute__((vector_size(LANES * sizeof(uint32_t))));
+
+// FA, FB and FC come from the bitsliced code. Evaluating fa and fb on the
+// state and its 1..3 bit shifts yields every nibble result at once, fc then
+// picks them up at bit 0, 4, 8, 12 and 16.
+static inline vec_t filter_vec(vec_t x) {
+    vec_t b = x >> 1, c = x >> 2, d = x >> 3;
+    vec_t fa = FA(x, b, c, d);
+    vec_t fb = FB(x, b, c, d);
+    return FC(fb >> 16, fa >> 12, fa >> 8, fb >> 4, fa) & 1;
+}
+
+static inline uint32_t filter_one(uint32_t x) {
+    uint32_t b = x >> 1, c = x >> 2, d = x >> 3;
+    uint32_t fa = FA(x, b, c, d);
+    uint32_t fb = FB(x, b, c, d);
+    return FC(fb >> 16, fa >> 12, fa >> 8, fb >> 4, fa) & 1;
+}
+
+static inline vec_t parity_vec(vec_t x) {
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return x & 1;
+}
+
+// load up to LANES entries, a short tail is padded with zeroes
+static inline vec_t load_vec(const uint32_t *p, size_t lanes) {
+    vec_t v = {0};
+    if (lanes == LANES)
+        memcpy(&v, p, sizeof(v));
+    else
+        for (size_t j = 0; j < lanes; j++)
+            v[j] = p[j];
+    return v;
+}
+
+/** filter_select_simd
+ * collect every state in [start, start + count) whose filter output is bit
+ */
+size_t KERNEL(filter_select_simd)(uint32_t *out, uint32_t start, uint32_t count, int bit) {
+    uint32_t keep[LANES];
+    vec_t x, step;
+    size_t o = 0;
+    uint32_t i = 0;
+
+    for (int j = 0; j < LANES; j++) {
+        x[j] = start + j;
+        step[j] = LANES;
+    }
+
+    for (; i + LANES <= count; i += LANES, x += step) {
+        vec_t k = filter_vec(x) ^ (uint32_t)bit ^ 1;
+        memcpy(keep, &k, sizeof(keep));
+        for (int j = 0; j < LANES; j++) {
+            out[o] = start + i + j;
+            o += keep[j];
+        }
+    }
+    for (; i < count; i++) {
+        out[o] = start + i;
+        o += filter_one(start + i) == (uint32_t)bit;
+    }
+    return o;
+}
+
+/** extend_table_simple_simd
+ * using a bit of the keystream extend the table of possible lfsr states
+ * every state v is replaced by the children 2v and 2v+1 whose filter matches bit
+ */
+size_t KERNEL(extend_table_simple_simd)(uint32_t *out, const uint32_t *in, size_t n, int bit) {
+    uint32_t first[LANES], cnt[LANES];
+    size_t o = 0;
+
+    for (size_t i = 0; i < n; i += LANES) {
+        size_t lanes = n - i < LANES ? n - i : LANES;
+        vec_t v = load_vec(in + i, lanes) << 1;
+        vec_t k0 = filter_vec(v) ^ (uint32_t)bit ^ 1;
+        vec_t k1 = filter_vec(v | 1) ^ (uint32_t)bit ^ 1;
+        // first slot holds 2v if it is kept, 2v+1 otherwise
+        vec_t c = v | (k0 ^ 1);
+        vec_t s = k0 + k1;
+        memcpy(first, &c, sizeof(first));
+        memcpy(cnt, &s, sizeof(cnt));
+        for (size_t j = 0; j < lanes; j++) {
+            out[o] = first[j];
+            out[o + 1] = first[j] | 1;
+            o += cnt[j];
+        }
+    }
+    return o;
+}
+
+/** extend_table_simd
+ * using a bit of the keystream extend the table of possible lfsr states,
+ * updating the partial feedback contributions kept in the top byte
+ */
+size_t KERNEL(extend_table_simd)(uint32_t *out, const uint32_t *in, size_t n, int bit,
+                         uint32_t m1, uint32_t m2, uint32_t in_bits) {
+    uint32_t first[LANES], second[LANES], cnt[LANES];
+    uint32_t flip = (m1 & 1) << 1 | (m2 & 1);
+    size_t o = 0;
+
+    in_bits <<= 24;
+    for (size_t i = 0; i < n; i += LANES) {
+        size_t lanes = n - i < LANES ? n - i : LANES;
+        vec_t v = load_vec(in + i, lanes) << 1;
+        vec_t k0 = filter_vec(v) ^ (uint32_t)bit ^ 1;
+        vec_t k1 = filter_vec(v | 1) ^ (uint32_t)bit ^ 1;
+
+        // the contribution of 2v+1 only differs where a mask covers bit 0
+        vec_t p = (v >> 25) << 2;
+        vec_t q = parity_vec(v & m1) << 1 | parity_vec(v & m2);
+        vec_t low = v & 0xffffff;
+        vec_t a = ((p | q) << 24 | low) ^ in_bits;
+        vec_t b = ((p | (q ^ flip)) << 24 | low | 1) ^ in_bits;
+
+        vec_t c = b ^ ((a ^ b) & -k0);
+        vec_t s = k0 + k1;
+        memcpy(first, &c, sizeof(first));
+        memcpy(second, &b, sizeof(second));
+        memcpy(cnt, &s, sizeof(cnt));
+        for (size_t j = 0; j < lanes; j++) {
+            out[o] = first[j];
+            out[o + 1] = second[j];
+            o += cnt[j];
+        }
+    }
+    return o;
+}
+
+/** lfsr_rollback_words_simd
+ * lfsr_rollback_word on n states, LANES of them at a time, the keystream is dropped
+ */
+void KERNEL(lfsr_rollback_words_simd)(struct Crypto1State *s, size_t n, uint32_t in, int fb) {
+    uint32_t f = fb ? 1 : 0;
+
+    for (size_t i = 0; i < n; i += LANES) {
+        size_t lanes = n - i < LANES ? n - i : LANES;
+        vec_t odd = {0}, even = {0};
+        for (size_t j = 0; j < lanes; j++) {
+            odd[j] = s[i + j].odd;
+            even[j] = s[i + j].even;
+        }
+        for (int b = 31; b >= 0; b--) {
+            vec_t t = odd & 0xffffff;
+            odd = even;
+            even = t >> 1;
+            vec_t out = (t & 1) ^ (even & LF_POLY_EVEN) ^ (odd & LF_POLY_ODD);
+            out = parity_vec(out) ^ BEBIT(in, b) ^ (filter_vec(odd) & f);
+            even |= out << 23;
+        }
+        for (size_t j = 0; j < lanes; j++) {
+            s[i + j].odd = odd[j];
+            s[i + j].even = even[j];
+        }
+    }
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Vectorized filter and table extension kernels used by lfsr_recovery32,
+// and the batched rollback of the states it returns
+//-----------------------------------------------------------------------------
+
+#ifndef CRAPTO1_SIMD_H__
+#define CRAPTO1_SIMD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The kernels work out of place: `out` must have room for 2 * n + 1 entries.
+// They return the number of entries written.
+// These go to the variant of the instruction set chosen, see crapto1_set_isa().
+
+size_t filter_select_simd(uint32_t *out, uint32_t start, uint32_t count, int bit);
+size_t extend_table_simple_simd(uint32_t *out, const uint32_t *in, size_t n, int bit);
+size_t extend_table_simd(uint32_t *out, const uint32_t *in, size_t n, int bit,
+                         uint32_t m1, uint32_t m2, uint32_t in_bits);
+// in place, lfsr_rollback_word of every state
+struct Crypto1State;
+void lfsr_rollback_words_simd(struct Crypto1State *s, size_t n, uint32_t in, int fb);
+
+// every build of crapto1_simd.c has its names suffixed by its instruction set
+#define KERNEL_ISA(name, isa) KERNEL_ISA_(name, isa)
+#define KERNEL_ISA_(name, isa) name##_##isa
+
+#define DECLARE_SIMD_KERNELS(isa) \
+    extern const char KERNEL_ISA(crapto1_simd_name, isa)[]; \
+    size_t KERNEL_ISA(filter_select_simd, isa)(uint32_t *out, uint32_t start, uint32_t count, int bit); \
+    size_t KERNEL_ISA(extend_table_simple_simd, isa)(uint32_t *out, const uint32_t *in, size_t n, int bit); \
+    size_t KERNEL_ISA(extend_table_simd, isa)(uint32_t *out, const uint32_t *in, size_t n, int bit, \
+                                              uint32_t m1, uint32_t m2, uint32_t in_bits); \
+    void KERNEL_ISA(lfsr_rollback_words_simd, isa)(struct Crypto1State *s, size_t n, uint32_t in, int fb);
+
+#endif
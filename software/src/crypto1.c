@@ -73,6 +73,30 @@ void crypto1_get_lfsr(struct Crypto1State *state, uint64_t *lfsr) {
         *lfsr = *lfsr << 1 | BIT(state->even, i ^ 3);
     }
 }
+// bit i of x to bit 2i, of the low 24 bits with the bits of every nibble reversed (i ^ 3)
+static inline uint64_t spread_lfsr_bits(uint32_t x) {
+    uint64_t v;
+
+    x = (x >> 2 & 0x333333) | (x & 0x333333) << 2;
+    x = (x >> 1 & 0x555555) | (x & 0x555555) << 1;
+    v = x;
+    v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+    v = (v | v << 8) & 0x00FF00FF00FF00FFull;
+    v = (v | v << 4) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | v << 2) & 0x3333333333333333ull;
+    v = (v | v << 1) & 0x5555555555555555ull;
+    return v;
+}
+
+/** crypto1_get_lfsrs
+ * crypto1_get_lfsr of an array of states, lfsr may be the same memory as states
+ */
+void crypto1_get_lfsrs(const struct Crypto1State *states, size_t n, uint64_t *lfsr) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t odd = states[i].odd, even = states[i].even;
+        lfsr[i] = spread_lfsr_bits(odd) << 1 | spread_lfsr_bits(even);
+    }
+}
 uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted) {
     uint32_t feedin, t;
     uint8_t ret = filter(s->odd);
@@ -143,11 +167,92 @@ uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted) {
     return ret;
 }
 
+/* prng_jumps
+ * Only bits 16..31 of the (endian swapped) prng state are ever fed back, so
+ * n >= 16 steps later the state is a linear function of those 16 bits alone.
+ * prng_jumps[k][i] is the state 2^(k + 4) steps after the one with only bit
+ * 16 + i set, the jump by 2^(k + 4) of any state is the xor of its columns.
+ */
+static const uint32_t prng_jumps[13][16] = {
+    {
+        0x68010001, 0xD0020002, 0xC8050004, 0xF80B0008, 0xF0160010, 0x882D0020, 0x105A0040, 0x20B40080,
+        0x41680100, 0x82D00200, 0x05A00400, 0x0B400800, 0x16801000, 0x2D002000, 0x5A004000, 0xB4008000
+    },
+    {
+        0x14416801, 0x2882D002, 0x4544C805, 0x9EC8F80B, 0x3D91F016, 0x6F62882D, 0xDEC5105A, 0xBD8A20B4,
+        0x7B144168, 0xF62882D0, 0xEC5105A0, 0xD8A20B40, 0xB1441680, 0x62882D00, 0xC5105A00, 0x8A20B400
+    },
+    {
+        0x97916B7B, 0x2F22D6F6, 0xC9D4C697, 0x0438E655, 0x0871CCAB, 0x8772F22D, 0x0EE5E45A, 0x1DCBC8B5,
+        0x3B97916B, 0x772F22D6, 0xEE5E45AD, 0xDCBC8B5B, 0xB97916B7, 0x72F22D6F, 0xE5E45ADE, 0xCBC8B5BD
+    },
+    {
+        0x527C3A7F, 0xA4F874FF, 0x1B8CD380, 0x65659D7E, 0xCACB3AFC, 0xC7EA4F87, 0x8FD49F0E, 0x1FA93E1D,
+        0x3F527C3A, 0x7EA4F874, 0xFD49F0E9, 0xFA93E1D3, 0xF527C3A7, 0xEA4F874F, 0xD49F0E9F, 0xA93E1D3F
+    },
+    {
+        0xA30091C7, 0x4601238F, 0x2F02D6D9, 0xFD053C75, 0xFA0A78EA, 0x57146012, 0xAE28C024, 0x5C518048,
+        0xB8A30091, 0x71460123, 0xE28C0247, 0xC518048E, 0x8A30091C, 0x14601238, 0x28C02471, 0x518048E3
+    },
+    {
+        0x8C055B69, 0x180AB6D2, 0xBC1036CC, 0xF42536F0, 0xE84A6DE1, 0x5C9180AB, 0xB9230156, 0x724602AD,
+        0xE48C055B, 0xC9180AB6, 0x9230156D, 0x24602ADB, 0x48C055B6, 0x9180AB6D, 0x230156DA, 0x4602ADB4
+    },
+    {
+        0xC047FFA7, 0x808FFF4F, 0xC1580138, 0x42F7FDD6, 0x85EFFBAC, 0xCB9808FF, 0x973011FF, 0x2E6023FF,
+        0x5CC047FF, 0xB9808FFF, 0x73011FFE, 0xE6023FFD, 0xCC047FFA, 0x9808FFF4, 0x3011FFE9, 0x6023FFD3
+    },
+    {
+        0x46921015, 0x8D24202A, 0x5CDA5040, 0xFF26B095, 0xFE4D612B, 0xBA08D242, 0x7411A484, 0xE8234908,
+        0xD0469210, 0xA08D2420, 0x411A4840, 0x82349080, 0x04692101, 0x08D24202, 0x11A48405, 0x2349080A
+    },
+    {
+        0x6B79E06C, 0xD6F3C0D8, 0xC69E61DC, 0xE64523D4, 0xCC8A47A8, 0xF26D6F3C, 0xE4DADE78, 0xC9B5BCF0,
+        0x936B79E0, 0x26D6F3C0, 0x4DADE781, 0x9B5BCF03, 0x36B79E06, 0x6D6F3C0D, 0xDADE781B, 0xB5BCF036
+    },
+    {
+        0xCE563461, 0x9CAC68C2, 0xF70EE5E4, 0x204BFFA9, 0x4097FF53, 0x4F79CAC6, 0x9EF3958D, 0x3DE72B1A,
+        0x7BCE5634, 0xF79CAC68, 0xEF3958D1, 0xDE72B1A3, 0xBCE56346, 0x79CAC68C, 0xF3958D18, 0xE72B1A30
+    },
+    {
+        0x67AF35CA, 0xCF5E6B95, 0xF913E2E0, 0x9588F00B, 0x2B11E016, 0x318CF5E6, 0x6319EBCD, 0xC633D79A,
+        0x8C67AF35, 0x18CF5E6B, 0x319EBCD7, 0x633D79AE, 0xC67AF35C, 0x8CF5E6B9, 0x19EBCD72, 0x33D79AE5
+    },
+    {
+        0x03FD088A, 0x07FA1115, 0x0C092AA0, 0x1BEF5DCA, 0x37DEBB95, 0x6C407FA1, 0xD880FF42, 0xB101FE84,
+        0x6203FD08, 0xC407FA11, 0x880FF422, 0x101FE844, 0x203FD088, 0x407FA111, 0x80FF4222, 0x01FE8445
+    },
+    {
+        0x8000BD0B, 0x00017A16, 0x80024926, 0x80042F47, 0x00085E8E, 0x80100017, 0x0020002F, 0x0040005E,
+        0x008000BD, 0x0100017A, 0x020002F4, 0x040005E8, 0x08000BD0, 0x100017A1, 0x20002F42, 0x40005E85
+    }
+};
+
+static inline uint32_t prng_jump(uint32_t x, const uint32_t *jump) {
+    uint32_t r = 0;
+    for (int i = 0; i < 16; i++)
+        r ^= jump[i] & -(x >> (16 + i) & 1);
+    return r;
+}
+
 /* prng_successor
  * helper used to obscure the keystream during authentication
+ * steps of 16 and more are taken with the jump tables, a few lookups whatever
+ * the distance
  */
 uint32_t prng_successor(uint32_t x, uint32_t n) {
+    uint32_t k;
+
     SWAPENDIAN(x);
+    if (n >= 16) {
+        // from 16 steps on the state runs along the 16 bit lfsr, of period 65535
+        if (n >= 16 + 0xFFFF)
+            n = 16 + (n - 16) % 0xFFFF;
+        for (k = 0; n >> (k + 4); k++)
+            if (n >> (k + 4) & 1)
+                x = prng_jump(x, prng_jumps[k]);
+        n &= 15;
+    }
     while (n--)
         x = x >> 1 | (x >> 16 ^ x >> 18 ^ x >> 19 ^ x >> 21) << 31;
 
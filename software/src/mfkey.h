@@ -14,10 +14,43 @@
 #define MFKEY_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "crapto1.h"
 
-uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info, uint64_t **keys);
+typedef struct {
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+
+    uint64_t par_list;
+    uint64_t ks_list;
+} DarksideParam;
+
+// incremental darkside, each nonce is only solved once
+typedef struct {
+    uint32_t uid;
+    uint32_t threads;       // of the prefix search, 0 = one per online cpu
+    uint64_t *candidates;   // sorted, -1 terminated keys common to the parity zero nonces so far
+} DarksideSolver;
+
+uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info,
+                   uint32_t threads, uint64_t **keys);
 
 int compare_uint64(const void *a, const void *b);
 uint32_t intersection(uint64_t *listA, uint64_t *listB);
 
+void darkside_solver_init(DarksideSolver *ds, uint32_t uid);
+uint32_t darkside_solver_add(DarksideSolver *ds, const DarksideParam *dp, uint64_t **keys);
+void darkside_solver_free(DarksideSolver *ds);
+uint64_t *darkside_recover(uint32_t uid, const DarksideParam *dps, uint32_t count, uint32_t threads,
+                           uint32_t *keyCount);
+bool mfkey32(uint32_t uid, uint32_t nt, uint32_t nr0_enc, uint32_t ar0_enc,
+             uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key);
+bool mfkey32v2(uint32_t uid, uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+               uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key);
+bool mfkey32v2_ctx(struct Crypto1Recovery *ctx, uint32_t uid, uint32_t nt0, uint32_t nr0_enc, uint32_t ar0_enc,
+                   uint32_t nt1, uint32_t nr1_enc, uint32_t ar1_enc, uint64_t *key);
+bool mfkey32_check(uint64_t key, uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc);
+bool mfkey64(uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc, uint32_t at_enc, uint64_t *key);
+
 #endif
@@ -4,9 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "crapto1.h"
+#include "mfkey.h"
 
 int main(int argc, char *argv[]) {
-    struct Crypto1State *s, *t;
     uint64_t key;     // recovered key
     uint32_t uid;     // serial number
     uint32_t nt;      // tag challenge
@@ -50,20 +50,8 @@ int main(int argc, char *argv[]) {
     ks2 = ar0_enc ^ p64;
     printf("  ks2: %08x\n", ks2);
 
-    s = lfsr_recovery32(ar0_enc ^ p64, 0);
-
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, nr0_enc, 1);
-        lfsr_rollback_word(t, uid ^ nt, 0);
-        crypto1_get_lfsr(t, &key);
-        crypto1_word(t, uid ^ nt, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64)) {
-            printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
-            break;
-        }
+    if (mfkey32(uid, nt, nr0_enc, ar0_enc, nr1_enc, ar1_enc, &key)) {
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
     }
-    free(s);
     return 0;
 }
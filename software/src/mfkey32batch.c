@@ -0,0 +1,278 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// mfkey32v2 over a whole detection log
+//
+// Reads reader authentication records, one per line:
+//     <uid hex>,<block>,<A|B>,<nt hex>,<{nr} hex>,<{ar} hex>
+// or the auth records of a capture file (capture.h),
+// groups them by uid, block and key type and tries the pairs of every group
+// on all cores. Every key found is checked against the rest of its group
+// right away, pairs of records it explains are not tried anymore.
+// Keys are printed as soon as they are found:
+//     <uid hex> <block> <A|B> <key hex>
+//-----------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pthread.h"
+#include "crapto1.h"
+#include "mfkey.h"
+#include "common.h"
+#include "capture.h"
+#include "thread_pool.h"
+
+typedef struct {
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+    bool solved;
+} AuthRecord;
+
+typedef struct {
+    uint32_t uid;
+    uint32_t block;
+    char type;
+
+    AuthRecord *records;
+    uint32_t count;
+    uint64_t *keys;
+    uint32_t keyCount;
+
+    uint32_t firstPair;     // index of the first pair of this group in the task list
+    pthread_mutex_t lock;
+} AuthGroup;
+
+static AuthGroup *groups;
+static uint32_t groupCount;
+static uint32_t pairCount;
+static struct Crypto1Recovery **contexts;
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static AuthGroup *find_group(uint32_t uid, uint32_t block, char type) {
+    for (uint32_t i = 0; i < groupCount; i++) {
+        if (groups[i].uid == uid && groups[i].block == block && groups[i].type == type) {
+            return &groups[i];
+        }
+    }
+    void *tmp = realloc(groups, sizeof(AuthGroup) * (groupCount + 1));
+    if (tmp == NULL) {
+        return NULL;
+    }
+    groups = tmp;
+    AuthGroup *g = &groups[groupCount++];
+    memset(g, 0, sizeof(AuthGroup));
+    g->uid = uid;
+    g->block = block;
+    g->type = type;
+    return g;
+}
+
+static bool add_record(uint32_t uid, uint32_t block, char type, uint32_t nt, uint32_t nr, uint32_t ar) {
+    AuthGroup *g = find_group(uid, block, type);
+    if (g == NULL) {
+        return false;
+    }
+    // the same answer twice would make any key candidate pass
+    for (uint32_t i = 0; i < g->count; i++) {
+        if (g->records[i].nt == nt && g->records[i].nr == nr && g->records[i].ar == ar) {
+            return true;
+        }
+    }
+    void *tmp = realloc(g->records, sizeof(AuthRecord) * (g->count + 1));
+    if (tmp == NULL) {
+        return false;
+    }
+    g->records = tmp;
+    g->records[g->count].nt = nt;
+    g->records[g->count].nr = nr;
+    g->records[g->count].ar = ar;
+    g->records[g->count].solved = false;
+    g->count++;
+    return true;
+}
+
+static bool load_records(FILE *f) {
+    char line[128];
+    uint32_t uid, block, nt, nr, ar;
+    char type;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%x,%u,%c,%x,%x,%x", &uid, &block, &type, &nt, &nr, &ar) != 6) {
+            continue;
+        }
+        type = (char)toupper((unsigned char)type);
+        if (type != 'A' && type != 'B') {
+            continue;
+        }
+        if (!add_record(uid, block, type, nt, nr, ar)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the auth records of a capture file
+static bool load_capture(const CaptureRecord *records, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const CaptureRecord *r = &records[i];
+        if (r->type == CAPTURE_AUTH &&
+                !add_record(r->uid, r->block, capture_key_type(r), r->nt, r->nr, r->ar)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// pair number `task` to group and records, pairs are numbered (0,1), (0,2) .. (1,2) ..
+static AuthGroup *pair_of_task(uint32_t task, uint32_t *i, uint32_t *j) {
+    uint32_t lo = 0, hi = groupCount - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (groups[mid].firstPair <= task) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    AuthGroup *g = &groups[lo];
+    uint32_t k = task - g->firstPair;
+    for (*i = 0; k >= g->count - 1 - *i; (*i)++) {
+        k -= g->count - 1 - *i;
+    }
+    *j = *i + 1 + k;
+    return g;
+}
+
+// Add a key to its group, marking every record it explains.
+static void add_key(AuthGroup *g, uint64_t key) {
+    bool known = false;
+
+    pthread_mutex_lock(&g->lock);
+    for (uint32_t i = 0; i < g->keyCount && !known; i++) {
+        known = g->keys[i] == key;
+    }
+    if (!known) {
+        void *tmp = realloc(g->keys, sizeof(uint64_t) * (g->keyCount + 1));
+        if (tmp != NULL) {
+            g->keys = tmp;
+            g->keys[g->keyCount++] = key;
+        }
+        for (uint32_t i = 0; i < g->count; i++) {
+            AuthRecord *r = &g->records[i];
+            if (!r->solved && mfkey32_check(key, g->uid, r->nt, r->nr, r->ar)) {
+                r->solved = true;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    if (!known) {
+        pthread_mutex_lock(&output_lock);
+        printf("%08x %u %c %012" PRIx64 "\n", g->uid, g->block, g->type, key);
+        fflush(stdout);
+        pthread_mutex_unlock(&output_lock);
+    }
+}
+
+static void solve_pair(void *ctx, uint32_t task, uint32_t worker) {
+    uint32_t i, j;
+    uint64_t key;
+    AuthGroup *g = pair_of_task(task, &i, &j);
+    AuthRecord a, b;
+    bool skip;
+    (void)ctx;
+
+    pthread_mutex_lock(&g->lock);
+    a = g->records[i];
+    b = g->records[j];
+    skip = a.solved || b.solved;
+    pthread_mutex_unlock(&g->lock);
+    if (skip) {
+        return;
+    }
+
+    if (contexts[worker] == NULL) {
+        contexts[worker] = lfsr_recovery_create();
+        if (contexts[worker] == NULL) {
+            return;
+        }
+    }
+    if (mfkey32v2_ctx(contexts[worker], g->uid, a.nt, a.nr, a.ar, b.nt, b.nr, b.ar, &key)) {
+        add_key(g, key);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    ToolOptions opts;
+    FILE *f = stdin;
+    uint32_t i, keys = 0;
+
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0) {
+        printf("syntax: %s [-t <threads>] [record file]\n", argv[0]);
+        printf("  one '<uid>,<block>,<A|B>,<nt>,<{nr}>,<{ar}>' per line or a capture file, stdin if no file\n");
+        return EXIT_FAILURE;
+    }
+    bool ok;
+    if (argi < argc) {
+        CaptureHeader header;
+        CaptureRecord *records;
+        uint32_t count;
+        int captured = capture_read(argv[argi], &header, &records, &count);
+        if (captured < 0) {
+            printf("Can't read %s\n", argv[argi]);
+            return EXIT_FAILURE;
+        }
+        if (captured > 0) {
+            ok = load_capture(records, count);
+            free(records);
+        } else {
+            f = fopen(argv[argi], "r");
+            if (f == NULL) {
+                printf("Can't open %s\n", argv[argi]);
+                return EXIT_FAILURE;
+            }
+            ok = load_records(f);
+            fclose(f);
+        }
+    } else {
+        ok = load_records(f);
+    }
+    if (!ok) {
+        printf("Can't malloc at record load.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < groupCount; i++) {
+        groups[i].firstPair = pairCount;
+        pairCount += groups[i].count * (groups[i].count - 1) / 2;
+        pthread_mutex_init(&groups[i].lock, NULL);
+    }
+
+    uint32_t workers = thread_pool_size(pairCount, opts.threads);
+    contexts = calloc(workers, sizeof(struct Crypto1Recovery *));
+    if (contexts == NULL) {
+        return EXIT_FAILURE;
+    }
+    thread_pool_run(pairCount, workers, solve_pair, NULL);
+
+    for (i = 0; i < workers; i++) {
+        lfsr_recovery_destroy(contexts[i]);
+    }
+    free(contexts);
+    for (i = 0; i < groupCount; i++) {
+        keys += groups[i].keyCount;
+        pthread_mutex_destroy(&groups[i].lock);
+        free(groups[i].records);
+        free(groups[i].keys);
+    }
+    free(groups);
+    fprintf(stderr, "%u key(s) found in %u group(s)\n", keys, groupCount);
+    return EXIT_SUCCESS;
+}
@@ -4,9 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "crapto1.h"
+#include "mfkey.h"
 
 int main(int argc, char *argv[]) {
-    struct Crypto1State *s, *t;
     uint64_t key;     // recovered key
     uint32_t uid;     // serial number
     uint32_t nt0;      // tag challenge first
@@ -46,7 +46,6 @@ int main(int argc, char *argv[]) {
     // Generate lfsr successors of the tag challenge
     printf("\nLFSR successors of the tag challenge:\n");
     uint32_t p64 = prng_successor(nt0, 64);
-    uint32_t p64b = prng_successor(nt1, 64);
 
     printf("  nt': %08x\n", p64);
     printf(" nt'': %08x\n", prng_successor(p64, 32));
@@ -56,21 +55,8 @@ int main(int argc, char *argv[]) {
     ks2 = ar0_enc ^ p64;
     printf("  ks2: %08x\n", ks2);
 
-    s = lfsr_recovery32(ar0_enc ^ p64, 0);
-
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, nr0_enc, 1);
-        lfsr_rollback_word(t, uid ^ nt0, 0);
-        crypto1_get_lfsr(t, &key);
-
-        crypto1_word(t, uid ^ nt1, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64b)) {
-            printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
-            break;
-        }
+    if (mfkey32v2(uid, nt0, nr0_enc, ar0_enc, nt1, nr1_enc, ar1_enc, &key)) {
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
     }
-    free(s);
     return 0;
 }
@@ -3,61 +3,105 @@
 #include <string.h>
 #include <inttypes.h>
 #include "common.h"
+#include "capture.h"
 #include "nested_util.h"
 
+static void print_keys(NtpKs1 *pNK, uint32_t size, uint32_t authuid, const ToolOptions *opts) {
+    uint32_t i, keyCount = 0;
+
+    if (opts->all_keys) {
+        countKeys *ck = nested_ranked(pNK, size, authuid, opts->threads, 0, &keyCount);
+        for (i = 0; i < keyCount; i++) {
+            printf("Key %d... %" PRIx64 " x%u \r\n", i + 1, ck[i].key, ck[i].count);
+        }
+        fflush(stdout);
+        free(ck);
+        return;
+    }
+    uint64_t *keys = nested_cached(pNK, size, authuid, opts->threads, opts->cache, opts->stream,
+                                   &keyCount);
+
+    if (keyCount > 0) {
+        for (i = 0; i < keyCount; i++) {
+            printf("Key %d... %" PRIx64 " \r\n", i + 1, keys[i]);
+            fflush(stdout);
+        }
+    }
+    fflush(stdout);
+    free(keys);
+}
+
+// every block and key type of the nested records of a capture file
+static bool solve_capture(const char *path, const ToolOptions *opts) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t count;
+
+    if (capture_read(path, &header, &records, &count) != 1) {
+        return false;
+    }
+    uint32_t targets = capture_target_count(records, count, CAPTURE_NESTED);
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].type != CAPTURE_NESTED || !capture_first_of_target(records, i)) {
+            continue;
+        }
+        NtpKs1 *pNK = NULL;
+        uint32_t j = 0;
+        for (uint32_t k = i; k < count; k++) {
+            const CaptureRecord *r = &records[k];
+            if (capture_same_target(r, &records[i]) &&
+                    !nested_add_nonce(&pNK, &j, r->nt, r->nt_enc, r->par, r->dist)) {
+                free(pNK);
+                free(records);
+                return false;
+            }
+        }
+        if (targets > 1) {
+            printf("Target block %u key %c\r\n", records[i].block, capture_key_type(&records[i]));
+        }
+        print_keys(pNK, j, header.auth_uid, opts);
+        free(pNK);
+    }
+    free(records);
+    return true;
+}
+
 int main(int argc, char *const argv[]) {
     NtpKs1 *pNK = NULL;
-    uint32_t i, j, m;
-    uint32_t nt1, nt2, nttest, ks1, dist;
+    uint32_t i, j = 0;
+    uint32_t nt1, nt2, dist;
+    ToolOptions opts;
     uint8_t par_int;
-    uint8_t par_arr[3] = { 0x00 };
 
-    uint32_t authuid = atoui(argv[1]);   // uid
-    dist = atoui(argv[2]);  // dist
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argi + 1 > argc) {
+        goto error;
+    }
+    // a capture file instead of the nonces, it already holds those of every run
+    if (argi + 1 == argc) {
+        opts.cache = NULL;
+        if (!solve_capture(argv[argi], &opts)) {
+            goto error;
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    uint32_t authuid = atoui(argv[argi]);   // uid
+    dist = atoui(argv[argi + 1]);  // dist
 
     // process all args.
-    for (i = 3, j = 0; i < argc; i += 3) {
+    for (i = argi + 2; i + 2 < argc; i += 3) {
         // nt + par
         nt1 = atoui(argv[i]);
         nt2 = atoui(argv[i + 1]);
         par_int = atoui(argv[i + 2]);
-        if (par_int != 0) {
-            for (m = 0; m < 3; m++) {
-                par_arr[m] = (par_int >> m) & 0x01;
-            }
-        } else {
-            memset(par_arr, 0, 3);
-        }
-        // Try to recover the keystream1
-        nttest = prng_successor(nt1, dist - 14);
-        for (m = dist - 14; m <= dist + 14; m += 1) {
-            ks1 = nt2 ^ nttest;
-            if (valid_nonce(nttest, nt2, ks1, par_arr)) {
-                ++j;
-                // append to list
-                void *tmp = realloc(pNK, sizeof(NtpKs1) * j);
-                if (tmp == NULL) {
-                    goto error;
-                }
-                pNK = tmp;
-                pNK[j - 1].ntp = nttest;
-                pNK[j - 1].ks1 = ks1;
-            }
-            nttest = prng_successor(nttest, 1);
+        if (!nested_add_nonce(&pNK, &j, nt1, nt2, par_int, dist)) {
+            goto error;
         }
     }
 
-    uint32_t keyCount = 0;
-    uint64_t *keys = nested(pNK, j, authuid, &keyCount);
-
-    if (keyCount > 0) {
-        for (i = 0; i < keyCount; i++) {
-            printf("Key %d... %" PRIx64 " \r\n", i + 1, keys[i]);
-            fflush(stdout);
-        }
-    }
-    fflush(stdout);
-    free(keys);
+    print_keys(pNK, j, authuid, &opts);
+    free(pNK);
     exit(EXIT_SUCCESS);
 error:
     exit(EXIT_FAILURE);
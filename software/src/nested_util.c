@@ -6,246 +6,742 @@
 #include <ctype.h>
 #include "parity.h"
 
-#if WIN32
-#include "windows.h"
-#else
-#include "unistd.h"
-#endif
-
-#include "pthread.h"
 #include "nested_util.h"
+#include "thread_pool.h"
+#include "pthread.h"
 
 
-#define MEM_CHUNK               10000
 #define TRY_KEYS                50
 
 
+// Provisional candidates printed while the nonces are solved, see nested_cached()
 typedef struct {
-    uint64_t       key;
-    int            count;
-} countKeys;
+    pthread_mutex_t lock;
+    countKeys *tally;   // hits of every key so far, sorted by key
+    uint32_t count;
+    uint32_t best;      // highest count printed
+    uint32_t done;      // entries of pNK merged
+    uint32_t size;
+} CandidateStream;
 
 typedef struct {
     NtpKs1 *pNK;
     uint32_t authuid;
+    CandidateStream *stream;    // NULL when not streaming
 
-    uint64_t *keys;
-    uint32_t keyCount;
+    // candidates of every nonce, merged once all of them are done
+    uint64_t **keys;
+    uint32_t *keyCount;
 
-    uint32_t startPos;
-    uint32_t endPos;
+    // recovery tables of every worker thread, created on first use
+    struct Crypto1Recovery **ctx;
 } RecPar;
 
+// LSD radix sort of the 48 bit keys, 16 bits per pass, tmp holds size keys.
+static void radix_sort48(uint64_t *keys, uint64_t *tmp, uint32_t size, uint32_t *hist) {
+    uint64_t *src = keys, *dst = tmp, *swap;
+    uint32_t i, d, sum;
 
-inline static int compar_int(const void *a, const void *b) {
-    if (*(uint64_t *)b == *(uint64_t *)a) return 0;
-    if (*(uint64_t *)b < * (uint64_t *)a) return 1;
-    return -1;
+    for (uint32_t shift = 0; shift < 48; shift += 16) {
+        memset(hist, 0, sizeof(uint32_t) << 16);
+        for (i = 0; i < size; i++) {
+            hist[(src[i] >> shift) & 0xFFFF]++;
+        }
+        // nothing to do if all the keys share this digit
+        if (hist[(src[0] >> shift) & 0xFFFF] == size) {
+            continue;
+        }
+        for (d = 0, sum = 0; d < 0x10000; d++) {
+            uint32_t n = hist[d];
+            hist[d] = sum;
+            sum += n;
+        }
+        for (i = 0; i < size; i++) {
+            dst[hist[(src[i] >> shift) & 0xFFFF]++] = src[i];
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != keys) {
+        memcpy(keys, src, size * sizeof(uint64_t));
+    }
 }
 
-// Compare countKeys structure
-int compar_special_int(const void *a, const void *b) {
-    return (((countKeys *)b)->count - ((countKeys *)a)->count);
+// Rank the candidate keys by the number of times they were found, most found first,
+// equal counts by key value. Only the top ones are returned, all of them if top is 0.
+// possibleKeys gets sorted. Returns NULL if out of memory.
+countKeys *rank_keys(uint64_t *possibleKeys, uint32_t size, uint32_t top, uint32_t *rankCount) {
+    uint32_t i, j, run, maxRun = 0, uniq = 0;
+    countKeys *ranked;
+
+    *rankCount = 0;
+    if (size == 0) {
+        return calloc(1, sizeof(countKeys));
+    }
+
+    uint64_t *tmp = malloc(size * sizeof(uint64_t));
+    uint32_t *hist = malloc(sizeof(uint32_t) << 16);
+    if (tmp == NULL || hist == NULL) {
+        free(tmp);
+        free(hist);
+        return NULL;
+    }
+    radix_sort48(possibleKeys, tmp, size, hist);
+    free(tmp);
+    free(hist);
+
+    for (i = 0; i < size; i += run) {
+        for (run = 1; i + run < size && possibleKeys[i + run] == possibleKeys[i]; run++);
+        if (run > maxRun) {
+            maxRun = run;
+        }
+        uniq++;
+    }
+
+    // counting sort on the count, only the places below top are filled
+    uint32_t *first = calloc(maxRun + 2, sizeof(uint32_t));
+    if (first == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < size; i += run) {
+        for (run = 1; i + run < size && possibleKeys[i + run] == possibleKeys[i]; run++);
+        first[run]++;
+    }
+    for (run = maxRun, j = 0; run > 0; run--) {
+        uint32_t n = first[run];
+        first[run] = j;
+        j += n;
+    }
+
+    *rankCount = (top == 0 || top > uniq) ? uniq : top;
+    ranked = malloc(*rankCount * sizeof(countKeys));
+    if (ranked == NULL) {
+        free(first);
+        *rankCount = 0;
+        return NULL;
+    }
+    for (i = 0; i < size; i += run) {
+        for (run = 1; i + run < size && possibleKeys[i + run] == possibleKeys[i]; run++);
+        j = first[run]++;
+        if (j < *rankCount) {
+            ranked[j].key = possibleKeys[i];
+            ranked[j].count = run;
+        }
+    }
+    free(first);
+    return ranked;
 }
 
-// keys qsort and unique.
-countKeys *uniqsort(uint64_t *possibleKeys, uint32_t size) {
-    unsigned int i, j = 0;
-    int count = 0;
-    countKeys *our_counts;
+// most found first, equal counts by key value
+static int compare_count(const void *a, const void *b) {
+    const countKeys *x = a, *y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return x->key < y->key ? -1 : x->key > y->key;
+}
 
-    qsort(possibleKeys, size, sizeof(uint64_t), compar_int);
+// sort and drop duplicates, returns the new size
+static uint32_t sort_unique(uint64_t *keys, uint32_t size, uint64_t *tmp, uint32_t *hist) {
+    uint32_t i, n = 0;
 
-    our_counts = calloc(size, sizeof(countKeys));
-    if (our_counts == NULL) {
-        printf("Memory allocation error for our_counts");
-        exit(EXIT_FAILURE);
+    if (size == 0) {
+        return 0;
     }
+    radix_sort48(keys, tmp, size, hist);
+    for (i = 1; i < size; i++) {
+        if (keys[i] != keys[n]) {
+            keys[++n] = keys[i];
+        }
+    }
+    return n + 1;
+}
 
-    for (i = 0; i < size; i++) {
-        if (possibleKeys[i + 1] == possibleKeys[i]) {
-            count++;
-        } else {
-            our_counts[j].key = possibleKeys[i];
-            our_counts[j].count = count;
-            j++;
-            count = 0;
+// Add the candidates of one entry of pNK to the tally and print the keys it
+// found again that are at least as often found as any printed so far, best
+// first. The counts printed only go up, the host can try the likely keys
+// before the solve is over. The output is only provisional, the final keys
+// are printed as without streaming.
+static void stream_candidates(CandidateStream *cs, const uint64_t *found, uint32_t size) {
+    uint32_t i, j, n = 0, raised = 0;
+
+    uint64_t *keys = malloc((size + 1) * sizeof(uint64_t));
+    uint64_t *tmp = malloc((size + 1) * sizeof(uint64_t));
+    uint32_t *hist = malloc(sizeof(uint32_t) << 16);
+    countKeys *rise = malloc((size + 1) * sizeof(countKeys));
+    if (keys == NULL || tmp == NULL || hist == NULL || rise == NULL) {
+        // the final output doesn't depend on it, this entry is just not streamed
+        goto done;
+    }
+    memcpy(keys, found, size * sizeof(uint64_t));
+    size = sort_unique(keys, size, tmp, hist);
+
+    pthread_mutex_lock(&cs->lock);
+    countKeys *merged = malloc((cs->count + size + 1) * sizeof(countKeys));
+    if (merged != NULL) {
+        for (i = 0, j = 0; i < cs->count || j < size;) {
+            if (j == size || (i < cs->count && cs->tally[i].key < keys[j])) {
+                merged[n++] = cs->tally[i++];
+            } else if (i == cs->count || keys[j] < cs->tally[i].key) {
+                merged[n].key = keys[j++];
+                merged[n++].count = 1;
+            } else {
+                merged[n].key = keys[j++];
+                merged[n].count = cs->tally[i++].count + 1;
+                rise[raised++] = merged[n++];
+            }
         }
+        free(cs->tally);
+        cs->tally = merged;
+        cs->count = n;
     }
-    qsort(our_counts, j, sizeof(countKeys), compar_special_int);
-    return (our_counts);
+    cs->done++;
+    if (raised > 0) {
+        qsort(rise, raised, sizeof(countKeys), compare_count);
+        if (rise[0].count > cs->best) {
+            cs->best = rise[0].count;
+        }
+        for (i = 0; i < raised && i < TRY_KEYS && rise[i].count >= cs->best; i++) {
+            printf("Candidate %012" PRIx64 " x%u %u/%u \r\n", rise[i].key, rise[i].count, cs->done, cs->size);
+        }
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&cs->lock);
+done:
+    free(keys);
+    free(tmp);
+    free(hist);
+    free(rise);
 }
 
-// nested decrypt
-static void *nested_revover(void *args) {
-    struct Crypto1State *revstate, * revstate_start = NULL;
-    uint64_t lfsr = 0;
-    uint32_t i, kcount = 0;
-    bool is_ok = true;
+// nested decrypt, one nonce per task
+static void nested_revover(void *args, uint32_t task, uint32_t worker) {
+    struct Crypto1State *revstate, *revstate_start;
+    uint32_t count = 0;
+    uint64_t *keys;
 
     RecPar *rp = (RecPar *)args;
+    uint32_t nt_probe = rp->pNK[task].ntp ^ rp->authuid;
+    uint32_t ks1 = rp->pNK[task].ks1;
+
+    if (rp->ctx[worker] == NULL) {
+        rp->ctx[worker] = lfsr_recovery_create();
+        if (rp->ctx[worker] == NULL) {
+            printf("Memory allocation error for lfsr_recovery_create");
+            return;
+        }
+    }
+
+    // And finally recover the first 32 bits of the key
+    revstate_start = lfsr_recovery32_ctx(rp->ctx[worker], ks1, nt_probe);
+    for (revstate = revstate_start; (revstate->odd != 0x0) || (revstate->even != 0x0); revstate++) {
+        count++;
+    }
 
-    rp->keyCount = 0;
-    rp->keys = NULL;
-
-    //printf("Start pos is %d, End pos is %d\r\n", rp->startPos, rp->endPos);
-
-    for (i = rp->startPos; i < rp->endPos; i++) {
-        uint32_t nt_probe = rp->pNK[i].ntp ^ rp->authuid;
-        uint32_t ks1 = rp->pNK[i].ks1;
-
-        /*
-        printf("     ntp = %"PRIu32"\r\n", nt_probe);
-        printf("     ks1 = %"PRIu32"\r\n", ks1);
-        printf("\r\n");
-        */
-
-        // And finally recover the first 32 bits of the key
-        revstate = lfsr_recovery32(ks1, nt_probe);
-        if (revstate_start == NULL) {
-            revstate_start = revstate;
-        }
-
-        while ((revstate->odd != 0x0) || (revstate->even != 0x0)) {
-            lfsr_rollback_word(revstate, nt_probe, 0);
-            crypto1_get_lfsr(revstate, &lfsr);
-            if (((kcount % MEM_CHUNK) == 0) || (kcount >= rp->keyCount)) {
-                rp->keyCount += MEM_CHUNK;
-                // printf("New chunk by %d, sizeof %lu\n", kcount, rp->keyCount * sizeof(uint64_t));
-                void *tmp = realloc(rp->keys, rp->keyCount * sizeof(uint64_t));
-                if (tmp == NULL) {
-                    printf("Memory allocation error for pk->possibleKeys");
-                    rp->keyCount = 0;
-                    is_ok = false;
-                    break;
+    keys = malloc((count + 1) * sizeof(uint64_t));
+    if (keys == NULL) {
+        printf("Memory allocation error for pk->possibleKeys");
+        return;
+    }
+    // the states of the table are not needed afterwards, roll them back in place
+    lfsr_rollback_words(revstate_start, count, nt_probe, 0);
+    crypto1_get_lfsrs(revstate_start, count, keys);
+
+    rp->keys[task] = keys;
+    rp->keyCount[task] = count;
+    if (rp->stream != NULL) {
+        stream_candidates(rp->stream, keys, count);
+    }
+}
+
+// candidates of every entry of pNK into rp->keys, rp->keyCount, streamed if stream isn't NULL
+static bool recover_all(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads,
+                        CandidateStream *stream, RecPar *rp) {
+    uint32_t workers = thread_pool_size(sizePNK, threads);
+
+    rp->pNK = pNK;
+    rp->authuid = authuid;
+    rp->stream = stream;
+    rp->keys = calloc(sizePNK, sizeof(uint64_t *));
+    rp->keyCount = calloc(sizePNK, sizeof(uint32_t));
+    rp->ctx = calloc(workers, sizeof(struct Crypto1Recovery *));
+    if (rp->keys == NULL || rp->keyCount == NULL || rp->ctx == NULL) {
+        free(rp->keys);
+        free(rp->keyCount);
+        free(rp->ctx);
+        return false;
+    }
+
+    thread_pool_run(sizePNK, workers, nested_revover, rp);
+    for (uint32_t i = 0; i < workers; i++) {
+        lfsr_recovery_destroy(rp->ctx[i]);
+    }
+    free(rp->ctx);
+    return true;
+}
+
+static void free_all(RecPar *rp, uint32_t sizePNK) {
+    for (uint32_t i = 0; i < sizePNK; i++) {
+        free(rp->keys[i]);
+    }
+    free(rp->keys);
+    free(rp->keyCount);
+}
+
+// rank all the candidates together, a key counts once per candidate nonce it came from
+static countKeys *rank_all(RecPar *rp, uint32_t sizePNK, uint32_t top, uint32_t *rankCount) {
+    uint32_t i, j, keyCount = 0;
+    uint64_t *keys;
+    countKeys *ck = NULL;
+
+    *rankCount = 0;
+    for (i = 0; i < sizePNK; i++) {
+        keyCount += rp->keyCount[i];
+    }
+
+    if (keyCount != 0) {
+        keys = malloc(keyCount * sizeof(uint64_t));
+        if (keys != NULL) {
+            for (i = 0, j = 0; i < sizePNK; i++) {
+                if (rp->keyCount[i] > 0) {
+                    memcpy(keys + j, rp->keys[i], rp->keyCount[i] * sizeof(uint64_t));
+                    j += rp->keyCount[i];
                 }
-                rp->keys = (uint64_t *)tmp;
             }
-            rp->keys[kcount] = lfsr;
-            kcount++;
-            revstate++;
-        }
-        --kcount;
-        free(revstate_start);
-        revstate_start = NULL;
-        if (!is_ok) {
-            break;
+            ck = rank_keys(keys, keyCount, top, rankCount);
+            if (ck == NULL) {
+                printf("Cannot allocate memory for ck on rank_keys.");
+            }
+            free(keys);
+        } else {
+            printf("Cannot allocate memory to merge keys.\r\n");
         }
     }
-    if (is_ok) {
-        if (kcount != 0) {
-            rp->keyCount = kcount;
-            void *tmp = (uint64_t *)realloc(rp->keys, rp->keyCount * sizeof(uint64_t));
-            if (tmp == NULL) {
-                printf("Memory allocation error for pk->possibleKeys");
-                rp->keyCount = 0;
-                free(rp->keys);
-            } else {
-                rp->keys = tmp;
-            }
+    return ck;
+}
+
+// keys of both sorted lists into a, returns their count
+static uint32_t intersect_sorted(uint64_t *a, uint32_t na, const uint64_t *b, uint32_t nb) {
+    uint32_t i = 0, j = 0, n = 0;
+
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            a[n++] = a[i++];
+            j++;
         }
-    } else {
-        rp->keyCount = 0;
-        free(rp->keys);
     }
-    return NULL;
+    return n;
 }
 
-uint64_t *nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t *keyCount) {
-#define THREAD_MAX 4
+static void free_sets(uint64_t **sets, uint32_t *setSize, uint32_t nonces) {
+    if (sets != NULL) {
+        for (uint32_t i = 0; i < nonces; i++) {
+            free(sets[i]);
+        }
+    }
+    free(sets);
+    free(setSize);
+}
 
-    *keyCount = 0;
-    uint32_t i, j, manyThread;
-    uint64_t *keys = (uint64_t *)NULL;
+// Sorted unique candidates of every acquired nonce into sets, setSize.
+// Returns false if out of memory.
+static bool nonce_sets(const RecPar *rp, const NtpKs1 *pNK, uint32_t sizePNK,
+                       uint64_t ***sets, uint32_t **setSize, uint32_t *nonces) {
+    uint32_t i, k, set, largest = 0;
+    uint64_t *tmp;
+    uint32_t *hist;
+
+    *sets = NULL;
+    *setSize = NULL;
+    *nonces = 0;
+    // the candidates of one nonce are adjacent, sizes of the per nonce unions
+    for (i = 0; i < sizePNK; i += k) {
+        uint32_t n = 0;
+        for (k = 0; i + k < sizePNK && pNK[i + k].nonce == pNK[i].nonce; k++) {
+            n += rp->keyCount[i + k];
+        }
+        if (n > largest) {
+            largest = n;
+        }
+        (*nonces)++;
+    }
+    if (*nonces == 0) {
+        return true;
+    }
 
-    manyThread = THREAD_MAX;
-    if (manyThread > sizePNK) {
-        manyThread = sizePNK;
+    *sets = calloc(*nonces, sizeof(uint64_t *));
+    *setSize = calloc(*nonces, sizeof(uint32_t));
+    tmp = malloc((largest + 1) * sizeof(uint64_t));
+    hist = malloc(sizeof(uint32_t) << 16);
+    bool ok = *sets != NULL && *setSize != NULL && tmp != NULL && hist != NULL;
+    for (i = 0, k = 0, set = 0; ok && i < sizePNK; i += k, set++) {
+        uint32_t n = 0;
+        for (k = 0; i + k < sizePNK && pNK[i + k].nonce == pNK[i].nonce; k++) {
+            n += rp->keyCount[i + k];
+        }
+        uint64_t *keys = malloc((n + 1) * sizeof(uint64_t));
+        if (keys == NULL) {
+            ok = false;
+            break;
+        }
+        for (k = 0, n = 0; i + k < sizePNK && pNK[i + k].nonce == pNK[i].nonce; k++) {
+            memcpy(keys + n, rp->keys[i + k], rp->keyCount[i + k] * sizeof(uint64_t));
+            n += rp->keyCount[i + k];
+        }
+        (*sets)[set] = keys;
+        (*setSize)[set] = sort_unique(keys, n, tmp, hist);
+    }
+    free(tmp);
+    free(hist);
+    if (!ok) {
+        free_sets(*sets, *setSize, *nonces);
+        *sets = NULL;
+        *setSize = NULL;
+        *nonces = 0;
     }
+    return ok;
+}
 
-    // pthread handle
-    pthread_t *threads = calloc(sizePNK, sizeof(pthread_t));
-    if (threads == NULL)  return NULL;
+// Keys found for every acquired nonce, sorted. A wrong key surviving two or more
+// nonces is very unlikely, the real one is in all of them unless a nonce is bad.
+// Returns NULL and count 0 for less than two nonces, an empty intersection or out of memory.
+static uint64_t *intersect_nonces(const RecPar *rp, const NtpKs1 *pNK, uint32_t sizePNK, uint32_t *count) {
+    uint32_t i, nonces, smallest = 0;
+    uint64_t **sets, *result = NULL;
+    uint32_t *setSize;
 
-    // Param
-    RecPar *pRPs = calloc(sizePNK, sizeof(RecPar));
-    if (pRPs == NULL) {
-        free(threads);
+    *count = 0;
+    if (!nonce_sets(rp, pNK, sizePNK, &sets, &setSize, &nonces)) {
         return NULL;
     }
+    if (nonces < 2) {
+        free_sets(sets, setSize, nonces);
+        return NULL;
+    }
+    for (i = 1; i < nonces; i++) {
+        if (setSize[i] < setSize[smallest]) {
+            smallest = i;
+        }
+    }
 
-    uint32_t average = sizePNK / manyThread;
-    uint32_t modules = sizePNK % manyThread;
-
-    // Assign tasks
-    for (i = 0, j = 0; i < manyThread; i++, j += average) {
-        pRPs[i].pNK = pNK;
-        pRPs[i].authuid = authuid;
-        pRPs[i].startPos = j;
-        pRPs[i].endPos = j + average;
-        pRPs[i].keys = NULL;
-        // last thread can decrypt more pNK
-        if (i == (manyThread - 1) && modules > 0) {
-            (pRPs[i].endPos) += modules;
+    // start from the smallest set, each merge can only shrink it
+    result = sets[smallest];
+    sets[smallest] = NULL;
+    *count = setSize[smallest];
+    for (i = 0; i < nonces && *count > 0; i++) {
+        if (sets[i] != NULL) {
+            *count = intersect_sorted(result, *count, sets[i], setSize[i]);
         }
-        pthread_create(&threads[i], NULL, nested_revover, &(pRPs[i]));
     }
+    if (*count == 0) {
+        free(result);
+        result = NULL;
+    }
+    free_sets(sets, setSize, nonces);
+    return result;
+}
+
+countKeys *nested_ranked(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads,
+                         uint32_t top, uint32_t *rankCount) {
+    RecPar rp;
+
+    *rankCount = 0;
+    if (!recover_all(pNK, sizePNK, authuid, threads, NULL, &rp)) {
+        return NULL;
+    }
+    countKeys *ck = rank_all(&rp, sizePNK, top, rankCount);
+    free_all(&rp, sizePNK);
+    return ck;
+}
 
-    for (i = 0; i < manyThread; i++) {
-        // wait thread exit...
-        pthread_join(threads[i], NULL);
-        *keyCount += pRPs[i].keyCount;
+static uint64_t *nested_stream(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads,
+                               CandidateStream *stream, uint32_t *keyCount) {
+    uint32_t i, n, rankCount;
+    uint64_t *keys = (uint64_t *)NULL;
+    RecPar rp;
+
+    *keyCount = 0;
+    if (!recover_all(pNK, sizePNK, authuid, threads, stream, &rp)) {
+        return NULL;
+    }
+    // The keys all the nonces agree on, most of the time only the right one
+    keys = intersect_nonces(&rp, pNK, sizePNK, &n);
+    if (keys != NULL) {
+        free_all(&rp, sizePNK);
+        *keyCount = n < TRY_KEYS ? n : TRY_KEYS;
+        return keys;
     }
-    free(threads);
 
-    if (*keyCount != 0) {
-        keys = malloc((*keyCount) * sizeof(uint64_t));
+    countKeys *ck = rank_all(&rp, sizePNK, TRY_KEYS, &rankCount);
+    free_all(&rp, sizePNK);
+    if (ck == NULL) {
+        return NULL;
+    }
+    // We don't known the key, try to break it with those found two or more times
+    for (n = 0; n < rankCount && ck[n].count > 1; n++);
+    if (n > 0) {
+        keys = malloc(n * sizeof(uint64_t));
         if (keys != NULL) {
-            for (i = 0, j = 0; i < manyThread; i++) {
-                if (pRPs[i].keyCount > 0) {
-                    // printf("The thread %d recover %d keys.\r\n", i, pRPs[i].keyCount);
-                    if (pRPs[i].keys != NULL) {
-                        memcpy(
-                            keys + j,
-                            pRPs[i].keys,
-                            pRPs[i].keyCount * sizeof(uint64_t)
-                        );
-                        j += pRPs[i].keyCount;
-                        free(pRPs[i].keys);
-                    }
-                }
+            for (i = 0; i < n; i++) {
+                keys[i] = ck[i].key;
             }
+            *keyCount = n;
+        } else {
+            printf("Cannot allocate memory for keys on merge.");
+        }
+    }
+    free(ck);
+    return keys;
+}
 
-            countKeys *ck = uniqsort(keys, *keyCount);
-            free(keys);
-            keys = (uint64_t *)NULL;
-            *keyCount = 0;
-
-            if (ck != NULL) {
-                for (i = 0; i < TRY_KEYS; i++) {
-                    // We don't known this key, try to break it
-                    // This key can be found here two or more times
-                    if (ck[i].count > 0) {
-                        *keyCount += 1;
-                        void *tmp = realloc(keys, sizeof(uint64_t) * (*keyCount));
-                        if (tmp != NULL) {
-                            keys = tmp;
-                            keys[*keyCount - 1] = ck[i].key;
-                        } else {
-                            printf("Cannot allocate memory for keys on merge.");
-                            free(keys);
-                            break;
-                        }
-                    }
-                }
+uint64_t *nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads, uint32_t *keyCount) {
+    return nested_stream(pNK, sizePNK, authuid, threads, NULL, keyCount);
+}
+
+/*
+ * Candidate cache of nested_cached, all values little endian:
+ *   "CUNK" version:u8 rfu:3 uid:u32 nonces:u32 count:u32
+ *   count times key:48 hits:u16, sorted by key
+ * nonces is the number of nonces of all the runs so far, hits how many of
+ * them had the key as a candidate.
+ */
+#define CACHE_MAGIC             "CUNK"
+#define CACHE_VERSION           1
+#define CACHE_HEADER_SIZE       20
+#define CACHE_ENTRY_SIZE        8
+
+static void put_le(uint8_t *p, uint64_t v, uint32_t len) {
+    while (len--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, uint32_t len) {
+    uint64_t v = 0;
+    while (len--) {
+        v = v << 8 | p[len];
+    }
+    return v;
+}
+
+// Candidates kept by the earlier runs, sorted by key. A missing file, one of
+// another card or an unreadable one is an empty cache.
+static countKeys *load_cache(const char *path, uint32_t uid, uint32_t *nonces, uint32_t *count) {
+    uint8_t head[CACHE_HEADER_SIZE], entry[CACHE_ENTRY_SIZE];
+    countKeys *ck = NULL;
+
+    *nonces = 0;
+    *count = 0;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fread(head, 1, sizeof(head), f) == sizeof(head) && memcmp(head, CACHE_MAGIC, 4) == 0 &&
+            head[4] == CACHE_VERSION && get_le(head + 8, 4) == uid) {
+        uint32_t n = (uint32_t)get_le(head + 16, 4);
+        ck = malloc((n + 1) * sizeof(countKeys));
+        if (ck != NULL) {
+            uint32_t i;
+            for (i = 0; i < n && fread(entry, 1, sizeof(entry), f) == sizeof(entry); i++) {
+                ck[i].key = get_le(entry, 6);
+                ck[i].count = (uint32_t)get_le(entry + 6, 2);
+            }
+            if (i == n) {
+                *nonces = (uint32_t)get_le(head + 12, 4);
+                *count = n;
             } else {
-                printf("Cannot allocate memory for ck on uniqsort.");
+                free(ck);
+                ck = NULL;
             }
-        } else {
-            printf("Cannot allocate memory to merge keys.\r\n");
         }
     }
-    free(pRPs);
+    fclose(f);
+    return ck;
+}
+
+static bool save_cache(const char *path, uint32_t uid, uint32_t nonces, const countKeys *ck, uint32_t count) {
+    uint8_t head[CACHE_HEADER_SIZE] = { 0 }, entry[CACHE_ENTRY_SIZE];
+    bool ok;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    memcpy(head, CACHE_MAGIC, 4);
+    head[4] = CACHE_VERSION;
+    put_le(head + 8, uid, 4);
+    put_le(head + 12, nonces, 4);
+    put_le(head + 16, count, 4);
+    ok = fwrite(head, 1, sizeof(head), f) == sizeof(head);
+    for (uint32_t i = 0; ok && i < count; i++) {
+        put_le(entry, ck[i].key, 6);
+        put_le(entry + 6, ck[i].count < 0xFFFF ? ck[i].count : 0xFFFF, 2);
+        ok = fwrite(entry, 1, sizeof(entry), f) == sizeof(entry);
+    }
+    return fclose(f) == 0 && ok;
+}
+
+// The cached candidates with those of every nonce set added, sorted by key
+static countKeys *merge_sets(const countKeys *old, uint32_t oldCount, uint64_t **sets, const uint32_t *setSize,
+                             uint32_t nonces, uint32_t *count) {
+    uint32_t i, j, n = 0, total = 0;
+    uint64_t *keys, *tmp;
+    uint32_t *hist;
+    countKeys *ck = NULL;
+
+    *count = 0;
+    for (i = 0; i < nonces; i++) {
+        total += setSize[i];
+    }
+    keys = malloc((total + 1) * sizeof(uint64_t));
+    tmp = malloc((total + 1) * sizeof(uint64_t));
+    hist = malloc(sizeof(uint32_t) << 16);
+    ck = malloc((oldCount + total + 1) * sizeof(countKeys));
+    if (keys == NULL || tmp == NULL || hist == NULL || ck == NULL) {
+        free(ck);
+        ck = NULL;
+        goto done;
+    }
+    for (i = 0, j = 0; i < nonces; i++) {
+        memcpy(keys + j, sets[i], setSize[i] * sizeof(uint64_t));
+        j += setSize[i];
+    }
+    if (total > 0) {
+        radix_sort48(keys, tmp, total, hist);
+    }
+
+    // both lists are sorted, equal keys of this run are adjacent
+    for (i = 0, j = 0; i < oldCount || j < total;) {
+        if (j == total || (i < oldCount && old[i].key < keys[j])) {
+            ck[n++] = old[i++];
+            continue;
+        }
+        uint64_t key = keys[j];
+        uint32_t hits = 0;
+        for (; j < total && keys[j] == key; j++) {
+            hits++;
+        }
+        if (i < oldCount && old[i].key == key) {
+            hits += old[i++].count;
+        }
+        ck[n].key = key;
+        ck[n++].count = hits;
+    }
+    *count = n;
+done:
+    free(keys);
+    free(tmp);
+    free(hist);
+    return ck;
+}
+
+// Keys to try out of the accumulated candidates: the ones every nonce of every run
+// agrees on, else the most found ones, at least twice.
+static uint64_t *select_cached(const countKeys *ck, uint32_t count, uint32_t nonces, uint32_t *keyCount) {
+    uint32_t i, n = 0;
+    uint64_t *keys = malloc(TRY_KEYS * sizeof(uint64_t));
+
+    *keyCount = 0;
+    if (keys == NULL) {
+        printf("Cannot allocate memory for keys on merge.");
+        return NULL;
+    }
+    if (nonces >= 2) {
+        for (i = 0; i < count && n < TRY_KEYS; i++) {
+            if (ck[i].count >= nonces) {
+                keys[n++] = ck[i].key;
+            }
+        }
+    }
+    if (n == 0) {
+        countKeys *ranked = malloc((count + 1) * sizeof(countKeys));
+        if (ranked != NULL) {
+            memcpy(ranked, ck, count * sizeof(countKeys));
+            qsort(ranked, count, sizeof(countKeys), compare_count);
+            for (; n < count && n < TRY_KEYS && ranked[n].count > 1; n++) {
+                keys[n] = ranked[n].key;
+            }
+            free(ranked);
+        }
+    }
+    if (n == 0) {
+        free(keys);
+        return NULL;
+    }
+    *keyCount = n;
+    return keys;
+}
+
+uint64_t *nested_cached(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads, const char *cache,
+                        bool stream, uint32_t *keyCount) {
+    uint32_t nonces, oldNonces = 0, oldCount = 0, count;
+    uint64_t **sets, *keys = NULL;
+    uint32_t *setSize;
+    countKeys *old = NULL, *ck;
+    CandidateStream cs = { .size = sizePNK };
+    RecPar rp;
+
+    *keyCount = 0;
+    if (cache != NULL) {
+        old = load_cache(cache, authuid, &oldNonces, &oldCount);
+    }
+    if (stream) {
+        // the keys of the earlier runs count from the start
+        pthread_mutex_init(&cs.lock, NULL);
+        if (oldCount > 0 && (cs.tally = malloc(oldCount * sizeof(countKeys))) != NULL) {
+            memcpy(cs.tally, old, oldCount * sizeof(countKeys));
+            cs.count = oldCount;
+        }
+    }
+    if (cache == NULL) {
+        keys = nested_stream(pNK, sizePNK, authuid, threads, stream ? &cs : NULL, keyCount);
+        goto done;
+    }
+    if (!recover_all(pNK, sizePNK, authuid, threads, stream ? &cs : NULL, &rp)) {
+        goto done;
+    }
+    bool ok = nonce_sets(&rp, pNK, sizePNK, &sets, &setSize, &nonces);
+    free_all(&rp, sizePNK);
+    if (!ok) {
+        printf("Cannot allocate memory to merge keys.\r\n");
+        goto done;
+    }
+
+    ck = merge_sets(old, oldCount, sets, setSize, nonces, &count);
+    free_sets(sets, setSize, nonces);
+    if (ck == NULL) {
+        printf("Cannot allocate memory to merge keys.\r\n");
+        goto done;
+    }
+    nonces += oldNonces;
+    // From the third nonce on the right key has two hits unless most nonces were bad,
+    // dropping the single ones keeps the file to a few times the candidates of a nonce.
+    if (nonces >= 3) {
+        uint32_t i, n;
+        for (i = 0, n = 0; i < count; i++) {
+            if (ck[i].count > 1) {
+                ck[n++] = ck[i];
+            }
+        }
+        count = n;
+    }
+    if (!save_cache(cache, authuid, nonces, ck, count)) {
+        printf("Cannot write the candidate cache %s\r\n", cache);
+    }
+    keys = select_cached(ck, count, nonces, keyCount);
+    free(ck);
+done:
+    if (stream) {
+        pthread_mutex_destroy(&cs.lock);
+        free(cs.tally);
+    }
+    free(old);
     return keys;
 }
 
@@ -257,3 +753,74 @@ uint8_t valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, uint8_t *parity)
                (oddparity8((Nt >> 8) & 0xFF) == ((parity[2]) ^ oddparity8((NtEnc >> 8) & 0xFF) ^ BIT(Ks1, 0)))
            ) ? 1 : 0;
 }
+
+// index the candidates of the next acquired nonce get
+static uint32_t next_nonce(const NtpKs1 *pNK, uint32_t sizePNK) {
+    return sizePNK > 0 ? pNK[sizePNK - 1].nonce + 1 : 0;
+}
+
+// append one nonce candidate
+static bool append_ntp_ks1(NtpKs1 **pNK, uint32_t *sizePNK, uint32_t ntp, uint32_t ks1, uint32_t nonce) {
+    void *tmp = realloc(*pNK, sizeof(NtpKs1) * (*sizePNK + 1));
+    if (tmp == NULL) {
+        return false;
+    }
+    *pNK = tmp;
+    (*pNK)[*sizePNK].ntp = ntp;
+    (*pNK)[*sizePNK].ks1 = ks1;
+    (*pNK)[*sizePNK].nonce = nonce;
+    (*sizePNK)++;
+    return true;
+}
+
+// Try to recover the keystream1 of a nested auth, every tag nonce around
+// dist steps after nt1 which matches the parity bits is a candidate.
+bool nested_add_nonce(NtpKs1 **pNK, uint32_t *sizePNK, uint32_t nt1, uint32_t nt2, uint8_t par_int, uint32_t dist) {
+    uint8_t par_arr[3] = { 0x00 };
+    uint32_t m, nttest, ks1;
+    uint32_t nonce = next_nonce(*pNK, *sizePNK);
+
+    for (m = 0; m < 3; m++) {
+        par_arr[m] = (par_int >> m) & 0x01;
+    }
+    nttest = prng_successor(nt1, dist - 14);
+    for (m = dist - 14; m <= dist + 14; m += 1) {
+        ks1 = nt2 ^ nttest;
+        if (valid_nonce(nttest, nt2, ks1, par_arr)) {
+            if (!append_ntp_ks1(pNK, sizePNK, nttest, ks1, nonce)) {
+                return false;
+            }
+        }
+        nttest = prng_successor(nttest, 1);
+    }
+    return true;
+}
+
+// Which generation of static tag is detected, gives the distance of the first nonce.
+bool staticnested_dist(uint32_t nt1, uint8_t type, uint32_t *dist) {
+    if (nt1 == 0x01200145) {
+        // There is no loophole in this generation.
+        // This tag can be decrypted with the default parameter value 160!
+        *dist = 160; // st gen1
+    } else if (nt1 == 0x009080A2) {   // st gen2
+        // We found that the gen2 tag is vulnerable too but parameter must be adapted depending on the attacked key
+        if (type == 0x61) {
+            *dist = 161;
+        } else if (type == 0x60) {
+            *dist = 160;
+        } else {
+            // can't be here!!!
+            return false;
+        }
+    } else {
+        // can't be here!!!
+        return false;
+    }
+    return true;
+}
+
+// the static nonce is known exactly, the next one is 160 steps further
+bool staticnested_add_nonce(NtpKs1 **pNK, uint32_t *sizePNK, uint32_t nt1, uint32_t nt2, uint32_t dist) {
+    uint32_t nttest = prng_successor(nt1, dist);
+    return append_ntp_ks1(pNK, sizePNK, nttest, nt2 ^ nttest, next_nonce(*pNK, *sizePNK));
+}
@@ -6,9 +6,33 @@
 typedef struct {
     uint32_t ntp;
     uint32_t ks1;
+    uint32_t nonce;     // acquired nonce this candidate comes from, candidates of one nonce are adjacent
 } NtpKs1;
 
+typedef struct {
+    uint64_t key;
+    uint32_t count;     // times the key was found
+} countKeys;
+
 uint8_t valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, uint8_t *parity);
-uint64_t *nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t *keyCount);
+bool nested_add_nonce(NtpKs1 **pNK, uint32_t *sizePNK, uint32_t nt1, uint32_t nt2, uint8_t par_int, uint32_t dist);
+bool staticnested_dist(uint32_t nt1, uint8_t type, uint32_t *dist);
+bool staticnested_add_nonce(NtpKs1 **pNK, uint32_t *sizePNK, uint32_t nt1, uint32_t nt2, uint32_t dist);
+countKeys *rank_keys(uint64_t *possibleKeys, uint32_t size, uint32_t top, uint32_t *rankCount);
+countKeys *nested_ranked(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads,
+                         uint32_t top, uint32_t *rankCount);
+uint64_t *nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads, uint32_t *keyCount);
+/** nested_cached
+ * nested() over this run and the earlier runs kept in the candidate file
+ * `cache` (of the same uid, else it is started over), which is updated.
+ * A key has to be a candidate of every nonce of all the runs, or of the
+ * most of them if a bad nonce left none, so each retry narrows it down.
+ * Same as nested() if cache is NULL.
+ * With stream, a "Candidate <key> x<hits> <done>/<entries>" line is printed
+ * every time a key is found again while the nonces are solved, before the
+ * final keys.
+ */
+uint64_t *nested_cached(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t threads, const char *cache,
+                        bool stream, uint32_t *keyCount);
 
 #endif
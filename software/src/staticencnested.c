@@ -0,0 +1,256 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Static encrypted nonce tags
+//
+//     staticencnested [-t <threads>] [-s] <uid> <{nt}> <{nt}> <{nt}>...
+//     staticencnested [-t <threads>] [-s] <capture file>
+//
+// These tags answer every nested authentication of a key with the same
+// encrypted nonce {nt}: nt and its keystream are reused, so a sector gives a
+// single {nt} however often it is acquired, and there is no distance to
+// search as for the weak or static PRNG tags. nt still is a 16 bit PRNG
+// nonce: the first {nt} (the target) leaves 2^16 plain nonces, each the key
+// candidates of one lfsr_recovery32, about 2^32 keys. The next ones are the
+// {nt} of other sectors: a key they share decrypts them to PRNG nonces too,
+// which a wrong key does once in 2^16. The keys decrypting at least two of
+// them are printed, those of the most sectors first, so the target key is
+// found if two other sectors share it. With n other sectors, a pair of them
+// lets about n(n-1)/2 wrong keys through as well. This takes 2^16 recoveries, about an
+// hour on one core; with -s a "Candidate <key> x<sectors>" line is printed
+// as soon as a key is found.
+// A capture file is solved for each of its targets against all the others.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pthread.h"
+#include "crapto1.h"
+#include "crypto1_bs.h"
+#include "common.h"
+#include "capture.h"
+#include "thread_pool.h"
+
+#define MIN_SHARED  2       // other sectors a key has to decrypt
+
+typedef struct {
+    uint64_t key;
+    uint32_t shared;        // other sectors the key decrypts
+} SharedKey;
+
+typedef struct {
+    uint32_t uid;
+    uint32_t nt_enc;        // of the target
+    const uint32_t *others; // {nt} of the other sectors
+    uint32_t otherCount;
+    bool stream;
+    struct Crypto1Recovery **ctx;
+    SharedKey *keys;
+    uint32_t keyCount;
+    pthread_mutex_t lock;
+} EncSolve;
+
+static int compare_shared(const void *a, const void *b) {
+    const SharedKey *x = a, *y = b;
+    return x->shared != y->shared ? (x->shared < y->shared) - (x->shared > y->shared)
+                                  : (x->key > y->key) - (x->key < y->key);
+}
+
+static void add_key(EncSolve *es, uint64_t key) {
+    struct Crypto1State s;
+    uint32_t shared = 0;
+
+    for (uint32_t i = 0; i < es->otherCount; i++) {
+        crypto1_init(&s, key);
+        shared += validate_prng_nonce(es->others[i] ^ crypto1_word(&s, es->uid ^ es->others[i], 1));
+    }
+    pthread_mutex_lock(&es->lock);
+    SharedKey *tmp = realloc(es->keys, sizeof(SharedKey) * (es->keyCount + 1));
+    if (tmp != NULL) {
+        es->keys = tmp;
+        es->keys[es->keyCount++] = (SharedKey) { key, shared };
+        if (es->stream) {
+            printf("Candidate %012" PRIx64 " x%u \r\n", key, shared);
+            fflush(stdout);
+        }
+    }
+    pthread_mutex_unlock(&es->lock);
+}
+
+// the keys of one plain nonce of the target, checked 64 at a time on the other sectors
+static void solve_nt(void *args, uint32_t task, uint32_t worker) {
+    EncSolve *es = (EncSolve *)args;
+    struct Crypto1State *states;
+    uint32_t nt = prng_successor(task + 1, 16);
+    uint32_t count = 0;
+    bitslice_t z[48 + 32];
+
+    if (es->ctx[worker] == NULL) {
+        es->ctx[worker] = lfsr_recovery_create();
+        if (es->ctx[worker] == NULL) {
+            printf("Memory allocation error for lfsr_recovery_create");
+            return;
+        }
+    }
+    states = lfsr_recovery32_ctx(es->ctx[worker], nt ^ es->nt_enc, nt ^ es->uid);
+    while (states[count].odd != 0 || states[count].even != 0) {
+        count++;
+    }
+    uint64_t *keys = malloc((count + 1) * sizeof(uint64_t));
+    if (keys == NULL) {
+        printf("Memory allocation error for keys");
+        return;
+    }
+    lfsr_rollback_words(states, count, nt ^ es->uid, 0);
+    crypto1_get_lfsrs(states, count, keys);
+
+    for (uint32_t k = 0; k < count; k += BS_LANES) {
+        int n = count - k < BS_LANES ? (int)(count - k) : BS_LANES;
+        bitslice_t once = 0, twice = 0;
+
+        crypto1_bs_load_keys(z, keys + k, n);
+        for (uint32_t i = 0; i < es->otherCount; i++) {
+            bitslice_t valid = crypto1_bs_valid_nt(z, 48, es->uid, es->others[i], BS_ONES);
+            twice |= once & valid;
+            once |= valid;
+        }
+        if (n < BS_LANES) {
+            twice &= ((bitslice_t)1 << n) - 1;
+        }
+        while (twice) {
+            int lane = __builtin_ctzll(twice);
+            twice &= twice - 1;
+            add_key(es, keys[k + lane]);
+        }
+    }
+    free(keys);
+}
+
+// target {nt} first, then those of the other sectors, duplicates allowed
+static bool solve(uint32_t uid, const uint32_t *nt_enc, uint32_t count, const ToolOptions *opts) {
+    EncSolve es;
+    uint32_t *others = malloc(sizeof(uint32_t) * count);
+    uint32_t i, j, otherCount = 0;
+
+    if (others == NULL) {
+        return false;
+    }
+    // the same sector acquired again, or a sector sharing the nonce and the key of the target
+    for (i = 1; i < count; i++) {
+        for (j = 0; j < otherCount && others[j] != nt_enc[i]; j++);
+        if (j == otherCount && nt_enc[i] != nt_enc[0]) {
+            others[otherCount++] = nt_enc[i];
+        }
+    }
+    if (otherCount < MIN_SHARED) {
+        printf("%u other sector nonce(s), at least %u needed\n", otherCount, MIN_SHARED);
+        free(others);
+        return true;
+    }
+
+    uint32_t workers = thread_pool_size(0xFFFF, opts->threads);
+    memset(&es, 0, sizeof(es));
+    es.uid = uid;
+    es.nt_enc = nt_enc[0];
+    es.others = others;
+    es.otherCount = otherCount;
+    es.stream = opts->stream;
+    es.ctx = calloc(workers, sizeof(struct Crypto1Recovery *));
+    if (es.ctx == NULL) {
+        free(others);
+        return false;
+    }
+    pthread_mutex_init(&es.lock, NULL);
+    // fills the nonce distance table shared by the threads
+    validate_prng_nonce(0);
+
+    thread_pool_run(0xFFFF, workers, solve_nt, &es);
+    for (i = 0; i < workers; i++) {
+        lfsr_recovery_destroy(es.ctx[i]);
+    }
+
+    qsort(es.keys, es.keyCount, sizeof(SharedKey), compare_shared);
+    for (i = 0; i < es.keyCount; i++) {
+        printf("Key %d... %012" PRIx64 " \r\n", i + 1, es.keys[i].key);
+    }
+    fflush(stdout);
+    pthread_mutex_destroy(&es.lock);
+    free(es.ctx);
+    free(es.keys);
+    free(others);
+    return true;
+}
+
+// every block and key type of the static encrypted nonce records of a capture file
+static bool solve_capture(const char *path, const ToolOptions *opts) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t count;
+    bool ok = true;
+
+    if (capture_read(path, &header, &records, &count) != 1) {
+        return false;
+    }
+    uint32_t *nt_enc = malloc(sizeof(uint32_t) * (count + 1));
+    if (nt_enc == NULL) {
+        free(records);
+        return false;
+    }
+    uint32_t targets = capture_target_count(records, count, CAPTURE_STATIC_ENC_NESTED);
+    for (uint32_t i = 0; ok && i < count; i++) {
+        if (records[i].type != CAPTURE_STATIC_ENC_NESTED || !capture_first_of_target(records, i)) {
+            continue;
+        }
+        uint32_t n = 0;
+        nt_enc[n++] = records[i].nt_enc;
+        for (uint32_t k = 0; k < count; k++) {
+            if (records[k].type == CAPTURE_STATIC_ENC_NESTED && !capture_same_target(&records[k], &records[i])) {
+                nt_enc[n++] = records[k].nt_enc;
+            }
+        }
+        if (targets > 1) {
+            printf("Target block %u key %c\r\n", records[i].block, capture_key_type(&records[i]));
+        }
+        ok = solve(header.auth_uid, nt_enc, n, opts);
+    }
+    free(nt_enc);
+    free(records);
+    return ok;
+}
+
+int main(int argc, char *const argv[]) {
+    ToolOptions opts;
+
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argi + 1 > argc) {
+        goto error;
+    }
+    // a capture file instead of the nonces
+    if (argi + 1 == argc) {
+        if (!solve_capture(argv[argi], &opts)) {
+            goto error;
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    uint32_t authuid = atoui(argv[argi]);   // uid
+    uint32_t count = argc - argi - 1;
+    uint32_t *nt_enc = malloc(sizeof(uint32_t) * count);
+    if (nt_enc == NULL) {
+        goto error;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        nt_enc[i] = atoui(argv[argi + 1 + i]);
+    }
+    if (!solve(authuid, nt_enc, count, &opts)) {
+        free(nt_enc);
+        goto error;
+    }
+    free(nt_enc);
+    exit(EXIT_SUCCESS);
+error:
+    exit(EXIT_FAILURE);
+}
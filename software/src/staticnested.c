@@ -3,71 +3,133 @@
 #include <string.h>
 #include <inttypes.h>
 #include "common.h"
+#include "capture.h"
 #include "nested_util.h"
 
-int main(int argc, char *const argv[]) {
-    NtpKs1 *pNK = NULL;
-    uint32_t i, j, m;
-    uint32_t nt1, nt2, nttest, ks1, dist;
+static void print_keys(NtpKs1 *pNK, uint32_t size, uint32_t authuid, const ToolOptions *opts) {
+    uint32_t i, keyCount = 0;
 
-    uint32_t authuid = atoui(argv[1]);   // uid
-    uint8_t type = (uint8_t)atoui(argv[2]); // target key type
+    if (opts->all_keys) {
+        countKeys *ck = nested_ranked(pNK, size, authuid, opts->threads, 0, &keyCount);
+        for (i = 0; i < keyCount; i++) {
+            printf("Key %d... %" PRIx64 " x%u \r\n", i + 1, ck[i].key, ck[i].count);
+        }
+        fflush(stdout);
+        free(ck);
+        return;
+    }
+    uint64_t *keys = nested_cached(pNK, size, authuid, opts->threads, opts->cache, opts->stream,
+                                   &keyCount);
 
-    // process all args.
-    bool check_st_level_at_first_run = false;
-    for (i = 3, j = 0; i < argc; i += 2) {
-        // nt + par
-        nt1 = atoui(argv[i]);
-        nt2 = atoui(argv[i + 1]);
+    if (keyCount > 0) {
+        for (i = 0; i < keyCount; i++) {
+            printf("Key %d... %" PRIx64 " \r\n", i + 1, keys[i]);
+            fflush(stdout);
+        }
+    }
+    fflush(stdout);
+    free(keys);
+}
+
+// nt, nt_enc pairs of one target, the distance follows from the first nt and grows by 160 per nonce
+static bool add_nonces(NtpKs1 **pNK, uint32_t *size, uint8_t type, const uint32_t *nt, uint32_t count) {
+    uint32_t dist = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t nt1 = nt[i * 2], nt2 = nt[i * 2 + 1];
 
         // Which generation of static tag is detected.
-        if (!check_st_level_at_first_run) {
-            if (nt1 == 0x01200145) {
-                // There is no loophole in this generation.
-                // This tag can be decrypted with the default parameter value 160!
-                dist = 160; // st gen1
-            } else if (nt1 == 0x009080A2) {   // st gen2
-                // We found that the gen2 tag is vulnerable too but parameter must be adapted depending on the attacked key
-                if (type == 0x61) {
-                    dist = 161;
-                } else if (type == 0x60) {
-                    dist = 160;
-                } else {
-                    // can't be here!!!
-                    goto error;
-                }
-            } else {
-                // can't be here!!!
-                goto error;
+        if (*size == 0 && !staticnested_dist(nt1, type, &dist)) {
+            return false;
+        }
+        if (!staticnested_add_nonce(pNK, size, nt1, nt2, dist)) {
+            return false;
+        }
+        dist += 160;
+    }
+    return true;
+}
+
+// every block and key type of the static nested records of a capture file
+static bool solve_capture(const char *path, const ToolOptions *opts) {
+    CaptureHeader header;
+    CaptureRecord *records;
+    uint32_t count;
+
+    if (capture_read(path, &header, &records, &count) != 1) {
+        return false;
+    }
+    uint32_t targets = capture_target_count(records, count, CAPTURE_STATIC_NESTED);
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].type != CAPTURE_STATIC_NESTED || !capture_first_of_target(records, i)) {
+            continue;
+        }
+        NtpKs1 *pNK = NULL;
+        uint32_t j = 0;
+        uint8_t type = 0x60 + (records[i].key & 1);
+        bool ok = true;
+        // the file holds every acquisition, the distance starts over with each of them
+        for (uint32_t k = i; ok && k < count; k++) {
+            uint32_t n, dist;
+            if (!capture_same_target(&records[k], &records[i])) {
+                continue;
             }
-            check_st_level_at_first_run = true;
+            uint32_t start = capture_run_start(records, k, &n);
+            ok = staticnested_dist(records[start].nt, type, &dist)
+                 && staticnested_add_nonce(&pNK, &j, records[k].nt, records[k].nt_enc, dist + 160 * n);
+        }
+        if (!ok) {
+            free(pNK);
+            continue;
         }
+        if (targets > 1) {
+            printf("Target block %u key %c\r\n", records[i].block, capture_key_type(&records[i]));
+        }
+        print_keys(pNK, j, header.auth_uid, opts);
+        free(pNK);
+    }
+    free(records);
+    return true;
+}
 
-        nttest = prng_successor(nt1, dist);
-        ks1 = nt2 ^ nttest;
-        ++j;
-        dist += 160;
+int main(int argc, char *const argv[]) {
+    NtpKs1 *pNK = NULL;
+    uint32_t i, j = 0;
+    uint32_t *nt;
+    ToolOptions opts;
 
-        void *tmp = realloc(pNK, sizeof(NtpKs1) * j);
-        if (tmp == NULL) {
+    int argi = parse_tool_options(argc, argv, &opts);
+    if (argi < 0 || argi + 1 > argc) {
+        goto error;
+    }
+    // a capture file instead of the nonces, it already holds those of every run
+    if (argi + 1 == argc) {
+        opts.cache = NULL;
+        if (!solve_capture(argv[argi], &opts)) {
             goto error;
         }
-
-        pNK = tmp;
-        pNK[j - 1].ntp = nttest;
-        pNK[j - 1].ks1 = ks1;
+        exit(EXIT_SUCCESS);
     }
-    uint32_t keyCount = 0;
-    uint64_t *keys = nested(pNK, j, authuid, &keyCount);
 
-    if (keyCount > 0) {
-        for (i = 0; i < keyCount; i++) {
-            printf("Key %d... %" PRIx64 " \r\n", i + 1, keys[i]);
-            fflush(stdout);
-        }
+    uint32_t authuid = atoui(argv[argi]);   // uid
+    uint8_t type = (uint8_t)atoui(argv[argi + 1]); // target key type
+
+    // process all args, nt + nt_enc
+    uint32_t count = (argc - argi - 2) / 2;
+    nt = malloc(sizeof(uint32_t) * 2 * (count + 1));
+    if (nt == NULL) {
+        goto error;
     }
-    fflush(stdout);
-    free(keys);
+    for (i = 0; i < count * 2; i++) {
+        nt[i] = atoui(argv[argi + 2 + i]);
+    }
+    if (!add_nonces(&pNK, &j, type, nt, count)) {
+        goto error;
+    }
+    free(nt);
+
+    print_keys(pNK, j, authuid, &opts);
+    free(pNK);
     exit(EXIT_SUCCESS);
 error:
     exit(EXIT_FAILURE);
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "pthread.h"
+#include "common.h"
+#include "thread_pool.h"
+
+// indexes [next, end) not yet started by the owning worker
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t next;
+    uint32_t end;
+} TaskRange;
+
+typedef struct {
+    TaskRange *ranges;
+    uint32_t workers;
+    ThreadPoolTask fn;
+    void *ctx;
+} ThreadPool;
+
+typedef struct {
+    ThreadPool *pool;
+    uint32_t id;
+    pthread_t handle;
+    bool started;
+} Worker;
+
+static bool take_task(TaskRange *r, uint32_t *task) {
+    bool ok = false;
+
+    pthread_mutex_lock(&r->lock);
+    if (r->next < r->end) {
+        *task = r->next++;
+        ok = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return ok;
+}
+
+// Move the upper half of the first non empty range found to the thief.
+static bool steal_task(ThreadPool *pool, uint32_t thief, uint32_t *task) {
+    for (uint32_t i = 1; i < pool->workers; i++) {
+        TaskRange *victim = &pool->ranges[(thief + i) % pool->workers];
+        uint32_t start = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            end = victim->end;
+            start = victim->next + (victim->end - victim->next) / 2;
+            victim->end = start;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (start < end) {
+            TaskRange *own = &pool->ranges[thief];
+            pthread_mutex_lock(&own->lock);
+            own->next = start + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            *task = start;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *pool_worker(void *args) {
+    Worker *w = (Worker *)args;
+    ThreadPool *pool = w->pool;
+    uint32_t task;
+
+    while (take_task(&pool->ranges[w->id], &task) || steal_task(pool, w->id, &task)) {
+        pool->fn(pool->ctx, task, w->id);
+    }
+    return NULL;
+}
+
+uint32_t thread_pool_size(uint32_t count, uint32_t threads) {
+    if (threads == 0) {
+        threads = get_cpu_count();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    return threads > 0 ? threads : 1;
+}
+
+void thread_pool_run(uint32_t count, uint32_t workers, ThreadPoolTask fn, void *ctx) {
+    ThreadPool pool;
+    uint32_t i;
+
+    if (count == 0) {
+        return;
+    }
+    // never asks the cpu count again, the caller sized its data for `workers`
+    pool.workers = workers < count ? workers : count;
+    if (pool.workers == 0) {
+        pool.workers = 1;
+    }
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.ranges = calloc(pool.workers, sizeof(TaskRange));
+    Worker *threads = calloc(pool.workers, sizeof(Worker));
+    if (pool.ranges == NULL || threads == NULL) {
+        // still get the work done, just on the calling thread
+        for (i = 0; i < count; i++) {
+            fn(ctx, i, 0);
+        }
+        goto out;
+    }
+
+    for (i = 0; i < pool.workers; i++) {
+        pthread_mutex_init(&pool.ranges[i].lock, NULL);
+        pool.ranges[i].next = (uint64_t)count * i / pool.workers;
+        pool.ranges[i].end = (uint64_t)count * (i + 1) / pool.workers;
+        threads[i].pool = &pool;
+        threads[i].id = i;
+    }
+
+    // the calling thread is worker 0
+    // the share of a thread that fails to start is stolen by the others
+    for (i = 1; i < pool.workers; i++) {
+        threads[i].started = pthread_create(&threads[i].handle, NULL, pool_worker, &threads[i]) == 0;
+    }
+    pool_worker(&threads[0]);
+    for (i = 1; i < pool.workers; i++) {
+        if (threads[i].started) {
+            pthread_join(threads[i].handle, NULL);
+        }
+    }
+
+    for (i = 0; i < pool.workers; i++) {
+        pthread_mutex_destroy(&pool.ranges[i].lock);
+    }
+out:
+    free(threads);
+    free(pool.ranges);
+}
@@ -0,0 +1,25 @@
+#ifndef THREAD_POOL_H__
+#define THREAD_POOL_H__
+
+#include <stdint.h>
+
+// Called once for every task index, worker is the index of the calling thread
+// in [0, threads) and can be used to pick per thread scratch data.
+typedef void (*ThreadPoolTask)(void *ctx, uint32_t task, uint32_t worker);
+
+/** thread_pool_size
+ * number of workers to run `count` tasks on `threads` threads (0 = one per
+ * online cpu), what the per worker data of the caller is sized for
+ */
+uint32_t thread_pool_size(uint32_t count, uint32_t threads);
+
+/** thread_pool_run
+ * run tasks 0 .. count - 1 on at most `workers` threads, as given by
+ * thread_pool_size(), worker ids stay below it. Returns once all of them are
+ * done. Every thread starts with an equal share of the indexes and steals
+ * half of the remaining share of another thread when it runs dry, so a few
+ * expensive tasks don't stall the others.
+ */
+void thread_pool_run(uint32_t count, uint32_t workers, ThreadPoolTask fn, void *ctx);
+
+#endif